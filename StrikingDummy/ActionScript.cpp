@@ -0,0 +1,177 @@
+#include "ActionScript.h"
+#include "BlackMage.h"
+#include "Parallel.h"
+#include "Rotation.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace StrikingDummy
+{
+	namespace
+	{
+		const char SCRIPT_MAGIC[8] = { 'S', 'D', 'S', 'C', 'R', 'I', 'P', 'T' };
+		const uint32_t VERSION = 1;
+
+		struct ScriptHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t seed;
+			int32_t mp_tick;
+			int32_t dot_tick;
+			int32_t lucid_tick;
+			int32_t duration;
+			uint32_t num_steps;
+		};
+	}
+
+	void ActionScript::record(BlackMage& blm, Rotation& rotation, unsigned int seed, int seconds)
+	{
+		this->seed = seed;
+		duration = seconds * 1000;
+
+		// the offsets come from the seed like in any fight, the fight then restarts from them with the
+		// rng reseeded, which is where a replay starts without drawing them
+		blm.rng.seed(seed);
+		blm.reset();
+		mp_tick = blm.mp_timer.time;
+		dot_tick = blm.dot_timer.time;
+		lucid_tick = blm.lucid_timer.time;
+		blm.rng.seed(seed);
+		blm.reset(mp_tick, dot_tick, lucid_tick);
+
+		while (blm.timeline.time < duration)
+			rotation.step();
+
+		steps.clear();
+		int time = 0;
+		for (size_t i = 0; i + 1 < blm.history.size(); i++)
+		{
+			steps.push_back({ time, blm.history[i].action });
+			time += blm.history[i].dt;
+		}
+	}
+
+	ReplayResult ActionScript::replay(const Stats& stats) const
+	{
+		Stats job_stats = stats;
+		BlackMage blm(job_stats);
+		blm.rng.seed(seed);
+		blm.reset(mp_tick, dot_tick, lucid_tick);
+
+		ReplayResult result;
+		size_t next = 0;
+		int waiting_since = -1;
+		while (next < steps.size() && blm.timeline.time < duration)
+		{
+			int action = steps[next].action;
+			if (std::find(blm.actions.begin(), blm.actions.end(), action) != blm.actions.end())
+			{
+				if (waiting_since >= 0)
+					result.wait += blm.timeline.time - waiting_since;
+				waiting_since = -1;
+				next++;
+			}
+			else
+			{
+				int wait = blm.can_use_action(BlackMage::NONE) ? BlackMage::NONE : BlackMage::WAIT_FOR_MP;
+				if (waiting_since < 0)
+					waiting_since = blm.timeline.time;
+				bool can_wait = std::find(blm.actions.begin(), blm.actions.end(), wait) != blm.actions.end();
+				if (action == BlackMage::NONE || !can_wait || blm.timeline.time - waiting_since >= max_wait)
+				{
+					// a NONE that is not usable just means the event it waited on already passed
+					if (action != BlackMage::NONE)
+						result.illegal.push_back((int)next);
+					waiting_since = -1;
+					next++;
+					continue;
+				}
+				action = wait;
+			}
+			blm.use_action(action);
+			blm.advance<BlackMage>();
+		}
+
+		result.damage = blm.total_damage;
+		result.time = blm.timeline.time;
+		return result;
+	}
+
+	std::vector<ReplayResult> ActionScript::replay(const std::vector<Stats>& stats, int num_threads) const
+	{
+		std::vector<ReplayResult> results(stats.size());
+		parallel_for((int)stats.size(), [&](int i)
+		{
+			results[i] = replay(stats[i]);
+		}, num_threads);
+		return results;
+	}
+
+	bool ActionScript::load(const char* filename)
+	{
+		std::fstream fs;
+		fs.open(filename, std::fstream::in | std::fstream::binary);
+		if (!fs.is_open())
+			return false;
+
+		ScriptHeader header;
+		fs.read((char*)&header, sizeof(header));
+		if (!fs || memcmp(header.magic, SCRIPT_MAGIC, sizeof(SCRIPT_MAGIC)) != 0 || header.version != VERSION)
+		{
+			std::cerr << filename << " is not an action script" << std::endl;
+			return false;
+		}
+
+		std::vector<int32_t> times(header.num_steps);
+		std::vector<uint8_t> actions(header.num_steps);
+		fs.read((char*)times.data(), times.size() * sizeof(int32_t));
+		fs.read((char*)actions.data(), actions.size());
+		if (!fs)
+		{
+			std::cerr << filename << " is truncated" << std::endl;
+			return false;
+		}
+
+		seed = header.seed;
+		mp_tick = header.mp_tick;
+		dot_tick = header.dot_tick;
+		lucid_tick = header.lucid_tick;
+		duration = header.duration;
+		steps.resize(header.num_steps);
+		for (size_t i = 0; i < steps.size(); i++)
+			steps[i] = { times[i], actions[i] };
+		return true;
+	}
+
+	// header, then all step times followed by all actions as single bytes
+	void ActionScript::save(const char* filename) const
+	{
+		ScriptHeader header;
+		memcpy(header.magic, SCRIPT_MAGIC, sizeof(SCRIPT_MAGIC));
+		header.version = VERSION;
+		header.seed = seed;
+		header.mp_tick = mp_tick;
+		header.dot_tick = dot_tick;
+		header.lucid_tick = lucid_tick;
+		header.duration = duration;
+		header.num_steps = (uint32_t)steps.size();
+
+		std::vector<int32_t> times;
+		std::vector<uint8_t> actions;
+		for (const Step& step : steps)
+		{
+			times.push_back(step.time);
+			actions.push_back((uint8_t)step.action);
+		}
+
+		std::fstream fs;
+		fs.open(filename, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+		fs.write((const char*)&header, sizeof(header));
+		fs.write((const char*)times.data(), times.size() * sizeof(int32_t));
+		fs.write((const char*)actions.data(), actions.size());
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Job.h"
+#include <vector>
+
+namespace StrikingDummy
+{
+	struct BlackMage;
+	struct Rotation;
+
+	struct ReplayResult
+	{
+		float damage = 0.0f;
+		int time = 0;				// ms, short of the recording when the script runs out
+		long long wait = 0;			// ms spent waiting on steps that were not usable yet
+		std::vector<int> illegal;	// steps that could not be used within max_wait and were skipped
+
+		double dps() const { return time > 0 ? 1000.0 * damage / time : 0.0; }
+	};
+
+	// A recorded fight: every decision of a BlackMage with the server tick offsets and rng seed it
+	// started from. Replaying it under other stats re-scores the same rotation without the model.
+	struct ActionScript
+	{
+		struct Step
+		{
+			int time;
+			int action;
+		};
+
+		unsigned int seed = 0;
+		int mp_tick = 0;
+		int dot_tick = 0;
+		int lucid_tick = 0;
+		int duration = 0;		// ms
+		std::vector<Step> steps;
+
+		int max_wait = 2500;	// how long a replay holds a step that is not usable before skipping it
+
+		void record(BlackMage& blm, Rotation& rotation, unsigned int seed, int seconds);
+
+		// Steps are used in order. One that is not usable yet is waited for (NONE, or WAIT_FOR_MP
+		// once the GCD is up), for at most max_wait before it is flagged illegal and skipped.
+		ReplayResult replay(const Stats& stats) const;
+		std::vector<ReplayResult> replay(const std::vector<Stats>& stats, int num_threads = 0) const;
+
+		bool load(const char* filename);
+		void save(const char* filename) const;
+	};
+}
@@ -1,12 +1,15 @@
 #include "BlackMage.h"
 #include "Logger.h"
 #include <assert.h>
+#include <cstring>
 #include <algorithm>
 #include <numeric>
 #include <chrono>
 #include <random>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <type_traits>
 
 #ifdef _DEBUG 
 #define DBG(x) x
@@ -32,13 +35,25 @@ namespace StrikingDummy
 		ll_fast_iii_gcd(lround(floor(0.1f * floor(0.5f * floor(0.85 * floor(this->stats.ss_multiplier * III_GCD))))) * 10)
 	{
 		actions.reserve(NUM_ACTIONS);
+		metrics.init(std::vector<std::string>(std::begin(blm_actions), std::end(blm_actions)), std::vector<std::string>(std::begin(blm_statuses), std::end(blm_statuses)));
 		reset();
 	}
 
 	void BlackMage::reset()
+	{
+		int mp_tick = tick(rng);
+		int dot_tick = tick(rng);
+		int lucid_tick = tick(rng);
+		reset(mp_tick, dot_tick, lucid_tick);
+	}
+
+	void BlackMage::reset(int mp_tick, int dot_tick, int lucid_tick)
 	{
 		timeline = {};
 
+		tc_rng.seed(rng());
+		fs_rng.seed(rng());
+
 		//mp = MAX_MP;
 		//mp = MAX_MP - B3_MP_COST;
 		mp = MAX_MP - F3_MP_COST;
@@ -51,9 +66,9 @@ namespace StrikingDummy
 		t3p = false;
 
 		// server ticks
-		mp_timer.reset(tick(rng), false);
-		dot_timer.reset(tick(rng), false);
-		lucid_timer.reset(tick(rng), false);
+		mp_timer.reset(mp_tick, false);
+		dot_timer.reset(dot_tick, false);
+		lucid_timer.reset(lucid_tick, false);
 		timeline.push_event(mp_timer.time);
 		timeline.push_event(dot_timer.time);
 		timeline.push_event(lucid_timer.time);
@@ -93,6 +108,8 @@ namespace StrikingDummy
 		cast_timer.reset(0, false);
 		action_timer.reset(0, true);
 		casting = Action::NONE;
+		macro = Action::NONE;
+		macro_step = 0;
 		casting_mp_cost = 0;
 
 		// precast
@@ -109,37 +126,43 @@ namespace StrikingDummy
 
 		// metrics
 		total_damage = 0.0f;
-		xeno_count = 0;
-		f1_count = 0;
-		f4_count = 0;
-		b4_count = 0;
-		t3_count = 0;
-		despair_count = 0;
-		transpose_count = 0;
-		lucid_count = 0;
-		pot_count = 0;
-		total_dot_time = 0;
-
-		total_f4_damage = 0.0f;
-		total_desp_damage = 0.0f;
-		total_xeno_damage = 0.0f;
-		total_t3_damage = 0.0f;
-		total_dot_damage = 0.0f;
-
-		sharp_last = -12000 + SHARP_CD;
-		
+		metrics.reset();
+		METRIC(metrics.ready_at(SHARP, SHARP_CD - 12000));
+
 		history.clear();
 
 		update_history();
 	}
 
+	static_assert(std::is_trivially_copyable<BlackMage::FightState>::value, "snapshots copy the fight state by assignment");
+
+	void BlackMage::snapshot(Snapshot& snapshot) const
+	{
+		// assign reuses the timeline's storage, so refreshing a snapshot does not allocate
+		snapshot.state = static_cast<const FightState&>(*this);
+		snapshot.timeline = timeline;
+		snapshot.total_damage = total_damage;
+	}
+
+	void BlackMage::restore(const Snapshot& snapshot)
+	{
+		static_cast<FightState&>(*this) = snapshot.state;
+		timeline = snapshot.timeline;
+		total_damage = snapshot.total_damage;
+		metrics.reset();
+
+		history.clear();
+		update_history();
+	}
+
 	void BlackMage::update(int elapsed)
 	{
 		DBG(assert(elapsed > 0));
 
-		// time metrics
-		if (dot.time > 0)
-			total_dot_time += elapsed;
+		metrics.time += elapsed;
+		if (dot.count > 0)
+			metrics.buff_time[THUNDER_DOT] += elapsed;
+		METRIC(update_metrics(elapsed));
 
 		if (element != Element::AF && mp != MAX_MP)
 			mp_wait += elapsed;
@@ -217,23 +240,30 @@ namespace StrikingDummy
 		actions.clear();
 		if (action_timer.ready)
 		{
+			// no decisions inside a macro, its transition runs on until the macro ends
+			if (macro != NONE && (!gcd_timer.ready || continue_macro()))
+				return;
+
 			for (int i = 0; i < NUM_ACTIONS; i++) if (can_use_action(i)) actions.push_back(i);
 			
 			if (actions.empty() || (actions.size() == 1 && actions[0] == NONE))
 				return;
 
-			// state/transition
+			// state/transition, encoded once for both ends
+			encode_state();
 			if (!history.empty())
 			{
 				Transition& t = history.back();
-				get_state(t.t1);
+				memcpy(t.t1, encoded_state, sizeof(float) * STATE_SIZE);
 				t.dt = timeline.time - t.dt;
-				t.actions = actions;
+				t.actions = 0;
+				for (int action : actions)
+					t.actions |= 1u << action;
 			}
 
 			history.emplace_back();
 			Transition& t = history.back();
-			get_state(t.t0);
+			memcpy(t.t0, encoded_state, sizeof(float) * STATE_SIZE);
 			t.reward = 0.0f;
 			t.dt = timeline.time;
 		}
@@ -267,13 +297,15 @@ namespace StrikingDummy
 
 	void BlackMage::update_dot()
 	{
+		// rolled on every tick, dot or not, so the n-th tick of fights from the same seed rolls the same
+		bool tc = random_procs && prob(tc_rng) < TC_PROC_RATE;
 		if (dot.count > 0)
 		{
 			float damage = get_dot_damage();
 			total_damage += damage;
-			total_dot_damage += damage;
+			metrics.tick(T3, damage);
 			history.back().reward += damage;
-			if (prob(rng) < TC_PROC_RATE)
+			if (tc)
 			{
 				tc_proc.reset(TC_DURATION, 1);
 				push_event(TC_DURATION);
@@ -302,38 +334,41 @@ namespace StrikingDummy
 		push_event(TICK_TIMER);
 	}
 
+	void BlackMage::update_metrics(int elapsed)
+	{
+		bool up[] =
+		{
+			element == UI, element == AF, enochian, swift.count > 0, triple.count > 0, sharp.count > 0, leylines.count > 0,
+			fs_proc.count > 0, tc_proc.count > 0, dot.count > 0, lucid.count > 0, pot.count > 0
+		};
+		// fight time and THUNDER_DOT are kept by update in every build
+		for (int status = 0; status < (int)(sizeof(up) / sizeof(up[0])); status++)
+			if (up[status] && status != THUNDER_DOT)
+				metrics.buff_time[status] += elapsed;
+	}
+
 	void BlackMage::update_metric(int action)
 	{
-		if (!metrics_enabled)
-			return;
+		metrics.cast(action);
 		switch (action)
 		{
 		case T3:
-			if (tc_proc.count > 0)
-				t3p_dist.push_back(timeline.time - t3_last);
-			else
-				t3_dist.push_back(timeline.time - t3_last);
-			t3_last = timeline.time + DOT_DURATION;
+			metrics.use(T3, timeline.time, DOT_DURATION);
 			break;
 		case SWIFT:
-			swift_dist.push_back(timeline.time - swift_last);
-			swift_last = timeline.time + SWIFT_CD;
+			metrics.use(SWIFT, timeline.time, SWIFT_CD);
 			break;
 		case TRIPLE:
-			triple_dist.push_back(timeline.time - triple_last);
-			triple_last = timeline.time + TRIPLE_CD;
+			metrics.use(TRIPLE, timeline.time, TRIPLE_CD);
 			break;
 		case SHARP:
-			sharp_dist.push_back(timeline.time - sharp_last);
-			sharp_last = timeline.time + SHARP_CD;
+			metrics.use(SHARP, timeline.time, SHARP_CD);
 			break;
 		case LEYLINES:
-			ll_dist.push_back(timeline.time - ll_last);
-			ll_last = timeline.time + LL_CD;
+			metrics.use(LEYLINES, timeline.time, LL_CD);
 			break;
 		case MANAFONT:
-			mf_dist.push_back(timeline.time - mf_last);
-			mf_last = timeline.time + MANAFONT_CD;
+			metrics.use(MANAFONT, timeline.time, MANAFONT_CD);
 			break;
 		}
 	}
@@ -458,6 +493,10 @@ namespace StrikingDummy
 			//return gcd_timer.ready && element != Element::AF;
 		case POT:
 			return pot_cd.ready;
+		case MACRO_F4:
+			return mp >= MACRO_F4_MP && can_use_action(F4) && get_gcd_time(F4) + get_cast_time(DESPAIR) < gauge.time;
+		case MACRO_REFRESH:
+			return element == AF && enochian && can_use_action(B3);
 		case UMBRAL_SOUL:
 			//return gcd_timer.ready && element == UI && enochian && gauge.count < 3;
 			return false;
@@ -467,8 +506,43 @@ namespace StrikingDummy
 
 	void BlackMage::use_action(int action)
 	{
-		int mp_time;
 		history.back().action = action;
+		if (action == MACRO_F4 || action == MACRO_REFRESH)
+		{
+			METRIC(metrics.cast(action));
+			macro = action;
+			macro_step = 0;
+			bool started = continue_macro();
+			assert(started);
+			(void)started;
+			return;
+		}
+		cast(action);
+	}
+
+	// casts the next gcd of the macro in progress, or ends the macro when that is not usable
+	bool BlackMage::continue_macro()
+	{
+		static constexpr int REFRESH[] = { B3, B4, F3 };
+
+		int action = NONE;
+		if (macro == MACRO_F4 && can_use_action(MACRO_F4))
+			action = F4;
+		else if (macro == MACRO_REFRESH && macro_step < 3 && can_use_action(REFRESH[macro_step]))
+			action = REFRESH[macro_step];
+		if (action == NONE)
+		{
+			macro = NONE;
+			return false;
+		}
+		macro_step++;
+		cast(action);
+		return true;
+	}
+
+	void BlackMage::cast(int action)
+	{
+		int mp_time;
 		switch (action)
 		{
 		case NONE:
@@ -495,18 +569,6 @@ namespace StrikingDummy
 		case XENO:
 		case DESPAIR:
 		case UMBRAL_SOUL:
-			if (action == XENO)
-				xeno_count++;
-			else if (action == F1)
-				f1_count++;
-			else if (action == F4)
-				f4_count++;
-			else if (action == B4)
-				b4_count++;
-			else if (action == T3)
-				t3_count++;
-			else if (action == DESPAIR)
-				despair_count++;
 			gcd_timer.reset(get_gcd_time(action), false);
 			cast_timer.reset(get_cast_time(action), false);
 			action_timer.reset(get_action_time(action), false);
@@ -567,10 +629,8 @@ namespace StrikingDummy
 			gauge.reset(GAUGE_DURATION, 1);
 			push_event(TRANSPOSE_CD);
 			push_event(GAUGE_DURATION);
-			transpose_count++;
 			break;
 		case LUCID:
-			lucid_count++;
 			skip_lucid_tick = lucid_timer.time <= ANIMATION_LOCK + ACTION_TAX;
 			lucid.reset(LUCID_DURATION, 1);
 			lucid_cd.reset(LUCID_CD, false);
@@ -578,7 +638,7 @@ namespace StrikingDummy
 			push_event(LUCID_CD);
 			break;
 		case POT:
-			pot_count++;
+			METRIC(update_metric(action));
 			pot.reset(POT_DURATION, 1);
 			pot_cd.reset(POT_CD, false);
 			push_event(POT_DURATION);
@@ -590,7 +650,7 @@ namespace StrikingDummy
 		// ogcd only
 		action_timer.reset(ANIMATION_LOCK + ACTION_TAX, false);
 		push_event(action_timer.time);
-		update_metric(action);
+		METRIC(update_metric(action));
 	}
 
 	void BlackMage::end_action()
@@ -600,7 +660,7 @@ namespace StrikingDummy
 		assert(cast_timer.ready || is_instant_cast(casting));
 		assert(mp >= casting_mp_cost);
 
-		update_metric(casting);
+		METRIC(update_metric(casting));
 
 		if (casting == DESPAIR)
 			mp = 0;
@@ -609,6 +669,7 @@ namespace StrikingDummy
 
 		float damage = get_damage(casting);
 		total_damage += damage;
+		metrics.hit(casting, damage);
 		history.back().reward += damage;
 
 		if (casting == F3 && fs_proc.count > 0);
@@ -675,7 +736,7 @@ namespace StrikingDummy
 				if (umbral_hearts > 0)
 					umbral_hearts--;
 			}
-			if (sharp.count > 0 || prob(rng) < FS_PROC_RATE)
+			if (sharp.count > 0 || (random_procs && prob(fs_rng) < FS_PROC_RATE))
 			{
 				fs_proc.reset(FS_DURATION, 1);
 				sharp.reset(0, 0);
@@ -694,7 +755,6 @@ namespace StrikingDummy
 		case F4:
 			if (umbral_hearts > 0)
 				umbral_hearts--;
-			total_f4_damage += damage;
 			break;
 		case T3:
 			if (t3p > 0)
@@ -707,18 +767,15 @@ namespace StrikingDummy
 				sharp.reset(0, 0);
 				push_event(TC_DURATION);
 			}
-			total_t3_damage += damage;
 			break;
 		case XENO:
 			assert(xeno_procs > 0);
 			xeno_procs--;
-			total_xeno_damage += damage;
 			break;
 		case DESPAIR:
 			element = AF;
 			gauge.reset(GAUGE_DURATION, 3);
 			push_event(GAUGE_DURATION);
-			total_desp_damage += damage;
 			break;
 		case UMBRAL_SOUL:
 			assert(element == UI);
@@ -971,67 +1028,57 @@ namespace StrikingDummy
 		//return T3_DOT_POTENCY * stats.potency_multiplier * stats.dot_multiplier * rng_multiplier * ((dot.count & 2) ? ENO_MULTIPLIER : 1.0f) * ((dot.count & 4) ? stats.pot_multiplier : 1.0f) * MAGICK_AND_MEND_MULTIPLIER;
 	}
 
-	void BlackMage::get_state(float* state)
+	void BlackMage::encode_state()
 	{
+		const bool flags[NUM_FLAGS] =
+		{
+			element == UI, element == AF, umbral_hearts > 0, enochian,
+			gauge.count > 0, gauge.count == 1, gauge.count == 2, gauge.count == 3,
+			xeno_procs > 0, xeno_procs > 1, swift.count > 0, sharp.count > 0,
+			leylines.count > 0, fs_proc.count > 0, tc_proc.count > 0,
+			dot.count > 0, (dot.count & 2) != 0, (dot.count & 4) != 0, lucid.count > 0,
+			swift_cd.ready, triple_cd.ready, sharp_cd.ready, leylines_cd.ready,
+			manafont_cd.ready, eno_cd.ready, lucid_cd.ready, gcd_timer.ready,
+			umbral_hearts == 1, umbral_hearts == 2, umbral_hearts == 3,
+			transpose_cd.ready, pot.count > 0, pot_cd.ready
+		};
+
+		float* state = encoded_state;
+		for (int i = 0; i < NUM_FLAGS; i++)
+			state[FLAG_FEATURES[i]] = flags[i];
+
 		state[0] = mp / (float)MAX_MP;
-		state[1] = element == UI;
-		state[2] = element == AF;
-		state[3] = umbral_hearts > 0;
-		state[4] = enochian;
-		state[5] = gauge.count > 0;
-		state[6] = gauge.count == 1;
-		state[7] = gauge.count == 2;
-		state[8] = gauge.count == 3;
 		state[9] = gauge.time / (float)GAUGE_DURATION;
-		state[10] = xeno_procs > 0;
-		state[11] = xeno_procs > 1;
 		state[12] = (XENO_TIMER - xeno_timer.time) / (float)XENO_TIMER;
-		state[13] = swift.count > 0;
 		state[14] = swift.time / (float)SWIFT_DURATION;
-		state[15] = sharp.count > 0;
 		state[16] = sharp.time / (float)SHARP_DURATION;
 		state[17] = triple.count / 3.0f;
 		state[18] = triple.time / (float)TRIPLE_DURATION;
-		state[19] = leylines.count > 0;
 		state[20] = leylines.time / (float)LL_DURATION;
-		state[21] = fs_proc.count > 0;
 		state[22] = fs_proc.time / (float)FS_DURATION;
-		state[23] = tc_proc.count > 0;
 		state[24] = tc_proc.time / (float)TC_DURATION;
-		state[25] = dot.count > 0;
 		state[26] = dot.time / (float)DOT_DURATION;
-		state[27] = (dot.count & 2) != 0;
-		state[28] = (dot.count & 4) != 0;
-		state[29] = lucid.count > 0;
 		state[30] = lucid.time / (float)LUCID_DURATION;
-		state[31] = swift_cd.ready;
 		state[32] = swift_cd.time / (float)SWIFT_CD;
-		state[33] = triple_cd.ready;
 		state[34] = triple_cd.time / (float)TRIPLE_CD;
-		state[35] = sharp_cd.ready;
 		state[36] = sharp_cd.time / (float)SHARP_CD;
-		state[37] = leylines_cd.ready;
 		state[38] = leylines_cd.time / (float)LL_CD;
-		state[39] = manafont_cd.ready;
 		state[40] = manafont_cd.time / (float)MANAFONT_CD;
-		state[41] = eno_cd.ready;
 		state[42] = eno_cd.time / (float)ENO_CD;
-		state[43] = lucid_cd.ready;
 		state[44] = lucid_cd.time / (float)LUCID_CD;
-		state[45] = gcd_timer.ready;
 		state[46] = gcd_timer.time / (BASE_GCD * 1000.0f);
-		state[47] = umbral_hearts == 1;
-		state[48] = umbral_hearts == 2;
-		state[49] = umbral_hearts == 3;
-		state[50] = transpose_cd.ready;
 		state[51] = transpose_cd.time / (float)TRANSPOSE_CD;
-		state[52] = pot.count > 0;
 		state[53] = pot.time / (float)POT_DURATION;
-		state[54] = pot_cd.ready;
 		state[55] = pot_cd.time / (float)POT_CD;
 		state[56] = mp_wait / (float)TICK_TIMER;
 	}
 
+	void BlackMage::get_state(float* state)
+	{
+		encode_state();
+		memcpy(state, encoded_state, sizeof(float) * STATE_SIZE);
+	}
+
 	std::string BlackMage::get_info()
 	{
 		return "\n";
@@ -1,10 +1,73 @@
 #pragma once
 
 #include "Job.h"
+#include "Metrics.h"
 
 namespace StrikingDummy
 {
-	struct BlackMage : public Job
+	// The plain-data part of a BlackMage fight. Snapshots copy it by assignment, so every field that
+	// decides how a fight goes on belongs here, and it has to stay trivially copyable.
+	struct BlackMageState
+	{
+		enum Element
+		{
+			NE, UI, AF
+		};
+
+		int mp = 10000;		// BlackMage::MAX_MP
+
+		Element element = Element::NE;
+		int umbral_hearts = 0;
+		bool enochian = false;
+		bool t3p = false;
+
+		// ticks
+		Timer mp_timer;
+		Timer dot_timer;
+		Timer lucid_timer;
+		int mp_wait = 0;
+
+		bool skip_lucid_tick = false;
+
+		// elemental gauge
+		Buff gauge;
+		Timer xeno_timer;
+		int xeno_procs = 0;
+
+		// buffs
+		Buff swift;
+		Buff sharp;
+		Buff triple;
+		Buff leylines;
+		Buff fs_proc;
+		Buff tc_proc;
+		Buff dot;	// NOT ACTUALLY A BUFF BUT YOU KNOW
+					// (value & 2) <=> enochian; (value & 4) <=> pot
+		Buff lucid;
+		Buff pot;
+
+		// cooldowns		
+		Timer swift_cd;
+		Timer triple_cd;
+		Timer sharp_cd;
+		Timer leylines_cd;
+		Timer manafont_cd;
+		Timer eno_cd;
+		Timer transpose_cd;
+		Timer lucid_cd;
+		Timer pot_cd;
+
+		// actions
+		Timer gcd_timer;
+		Timer cast_timer;
+		Timer action_timer;
+		int casting = 0;		// BlackMage::NONE
+		int macro = 0;			// macro-action in progress
+		int macro_step = 0;
+		int casting_mp_cost = 0;
+	};
+
+	struct BlackMage final : public Job, public BlackMageState
 	{
 		enum Action
 		{
@@ -12,26 +75,52 @@ namespace StrikingDummy
 			B1, B3, B4, F1, F3, F4, T3, XENO, DESPAIR,
 			SWIFT, TRIPLE, SHARP, LEYLINES, MANAFONT, ENOCHIAN, TRANSPOSE,
 			LUCID, WAIT_FOR_MP,
-			POT, FREEZE, UMBRAL_SOUL
+			POT, MACRO_F4, MACRO_REFRESH,
+			FREEZE, UMBRAL_SOUL
 		};
 
-		enum Element
+		using FightState = BlackMageState;
+
+		// buffs and states whose uptime is tracked in metrics
+		enum Status
 		{
-			NE, UI, AF
+			IN_UI, IN_AF, IN_ENOCHIAN, SWIFTCAST, TRIPLECAST, SHARPCAST, IN_LEYLINES,
+			FIRESTARTER, THUNDERCLOUD, THUNDER_DOT, LUCID_DREAMING, TINCTURE
+		};
+
+		static constexpr const char* blm_statuses[12] =
+		{
+			"UI", "AF", "ENOCHIAN", "SWIFTCAST", "TRIPLECAST", "SHARPCAST", "LEYLINES",
+			"FIRESTARTER", "THUNDERCLOUD", "DOT", "LUCID", "TINCTURE"
 		};
 
-		std::string blm_actions[22] =
+		static constexpr const char* blm_actions[24] =
 		{
 			"NONE",
 			"B1", "B3", "B4", "F1", "F3", "F4", "T3", "XENO", "DESPAIR",
 			"SWIFT", "TRIPLE", "SHARP", "LEYLINES", "MANAFONT", "ENOCHIAN", "TRANSPOSE",
 			"LUCID", "WAIT_FOR_MP",
-			"HQ_TINCTURE_OF_INTELLIGENCE", "FREEZE", "UMBRAL_SOUL"
+			"HQ_TINCTURE_OF_INTELLIGENCE", "MACRO_F4", "MACRO_REFRESH",
+			"FREEZE", "UMBRAL_SOUL"
 		};
 
 		static constexpr float BLM_ATTR = 115.0f;
 
-		static constexpr int NUM_ACTIONS = 20;
+		// Macro-actions cast several gcds for one decision and one transition: MACRO_F4 casts F4 until MP
+		// drops below MACRO_F4_MP or the gcd after it could not refresh AF in time, MACRO_REFRESH casts B3,
+		// B4, F3. A macro hands control back early when its next gcd is not usable, and skips the oGCD
+		// windows it passes. They add network outputs.
+		static constexpr bool MACRO_ACTIONS = false;
+		static constexpr int NUM_ACTIONS = MACRO_ACTIONS ? 22 : 20;
+		static constexpr int STATE_SIZE = 57;
+
+		// state indices of the 0/1 features, in the order encode_state lists them
+		static constexpr int FLAG_FEATURES[] =
+		{
+			1, 2, 3, 4, 5, 6, 7, 8, 10, 11, 13, 15, 19, 21, 23, 25, 27, 28, 29,
+			31, 33, 35, 37, 39, 41, 43, 45, 47, 48, 49, 50, 52, 54
+		};
+		static constexpr int NUM_FLAGS = sizeof(FLAG_FEATURES) / sizeof(FLAG_FEATURES[0]);
 
 		static constexpr int ACTION_TAX = 117;
 		static constexpr int CAST_LOCK = 500;
@@ -111,6 +200,7 @@ namespace StrikingDummy
 		static constexpr int FREEZE_MP_COST = 1000;
 		static constexpr int T3_MP_COST = 400;
 		static constexpr int DESPAIR_MP_COST = 800;
+		static constexpr int MACRO_F4_MP = 2 * F4_MP_COST + DESPAIR_MP_COST;	// one more F4 without hearts, then Despair
 
 		const int base_gcd;
 		const int iii_gcd;
@@ -125,93 +215,32 @@ namespace StrikingDummy
 		const int ll_fast_base_gcd;
 		const int ll_fast_iii_gcd;
 
-		int mp = MAX_MP;
-
-		Element element = Element::NE;
-		int umbral_hearts = 0;
-		bool enochian = false;
-		bool t3p = false;
-
-		// ticks
-		Timer mp_timer;
-		Timer dot_timer;
-		Timer lucid_timer;
-		int mp_wait = 0;
-
-		bool skip_lucid_tick = false;
-
-		// elemental gauge
-		Buff gauge;
-		Timer xeno_timer;
-		int xeno_procs = 0;
-
-		// buffs
-		Buff swift;
-		Buff sharp;
-		Buff triple;
-		Buff leylines;
-		Buff fs_proc;
-		Buff tc_proc;
-		Buff dot;	// NOT ACTUALLY A BUFF BUT YOU KNOW
-					// (value & 2) <=> enochian; (value & 4) <=> pot
-		Buff lucid;
-		Buff pot;
+		// Thundercloud and Firestarter procs that are not guaranteed; off for deterministic searches
+		bool random_procs = true;
 
-		// cooldowns		
-		Timer swift_cd;
-		Timer triple_cd;
-		Timer sharp_cd;
-		Timer leylines_cd;
-		Timer manafont_cd;
-		Timer eno_cd;
-		Timer transpose_cd;
-		Timer lucid_cd;
-		Timer pot_cd;
+		// Each proc rolls from its own stream, seeded from rng by reset. Fights started from the same seed
+		// then share the server ticks and the n-th roll of each proc, whatever the policy or stats.
+		std::mt19937 tc_rng;	// one roll per server dot tick
+		std::mt19937 fs_rng;	// one roll per F1
 
-		// actions
-		Timer gcd_timer;
-		Timer cast_timer;
-		Timer action_timer;
-		int casting = Action::NONE;
-		int casting_mp_cost = 0;
+		// casts, drift and most uptimes are recorded only in SD_METRICS builds
+		Metrics metrics;
 
-		// count metrics
-		int xeno_count = 0;
-		int f1_count = 0;
-		int f4_count = 0;
-		int b4_count = 0;
-		int t3_count = 0;
-		int despair_count = 0;
-		int transpose_count = 0;
-		int lucid_count = 0;
-		int pot_count = 0;
-		int total_dot_time = 0;
-
-		// distribution metrics
-		bool metrics_enabled = false;
-		std::vector<int> t3_dist;
-		std::vector<int> t3p_dist;
-		std::vector<int> swift_dist;
-		std::vector<int> triple_dist;
-		std::vector<int> sharp_dist;
-		std::vector<int> ll_dist;
-		std::vector<int> mf_dist;
-		int t3_last = 0;
-		int swift_last = 0;
-		int triple_last = 0;
-		int sharp_last = 0;
-		int ll_last = 0;
-		int mf_last = 0;
-
-		float total_f4_damage = 0.0f;
-		float total_desp_damage = 0.0f;
-		float total_xeno_damage = 0.0f;
-		float total_t3_damage = 0.0f;
-		float total_dot_damage = 0.0f;
+		// A decision point of a fight. The rng is not part of it, so fights restored from the same
+		// snapshot go their own ways, and a restored fight starts a new history.
+		struct Snapshot
+		{
+			FightState state;
+			Timeline timeline;
+			float total_damage = 0.0f;
+		};
 
 		BlackMage(Stats& stats);
 
 		void reset();
+		void reset(int mp_tick, int dot_tick, int lucid_tick);	// server tick offsets in ms, for replays
+		void snapshot(Snapshot& snapshot) const;
+		void restore(const Snapshot& snapshot);
 		void update(int elapsed);
 		void update_history();
 
@@ -219,6 +248,7 @@ namespace StrikingDummy
 		void update_dot();
 		void update_lucid();
 
+		void update_metrics(int elapsed);
 		void update_metric(int action);
 
 		bool is_instant_cast(int action) const;
@@ -230,14 +260,23 @@ namespace StrikingDummy
 
 		bool can_use_action(int action) const;
 		void use_action(int action);
+		void cast(int action);
+		bool continue_macro();
 		void end_action();
 
 		int get_mp_cost(int action) const;
 		float get_damage(int action);
 		float get_dot_damage();
 
+		// last encoded state, update_history copies it into both ends of a transition
+		float encoded_state[64] = {};
+
+		void encode_state();
+
+		using Job::get_state;
 		void get_state(float* state);
-		int get_state_size() { return 57; }
+		int get_state_size() { return STATE_SIZE; }
+		std::vector<int> get_state_flags() { return std::vector<int>(FLAG_FEATURES, FLAG_FEATURES + NUM_FLAGS); }
 		int get_num_actions() { return NUM_ACTIONS; }
 		std::string get_action_name(int action) { return blm_actions[action]; }
 		std::string get_info();
@@ -1,12 +1,53 @@
 #include "CUDA.cuh"
+#include "Memory.h"
 #include <iostream>
 #include <chrono>
+#include <mutex>
+#include <unordered_map>
 #include <math.h>
 #include <curand.h>
+#include <cuda_fp16.h>
+
+using StrikingDummy::Memory::allocated;
+using StrikingDummy::Memory::freed;
+using StrikingDummy::MemoryTag;
 
 int blockSize = 0;
 bool cuda_init = false;
 
+// sizes of the live device allocations, so that frees can be accounted for
+std::mutex device_mutex;
+std::unordered_map<const void*, size_t> device_bytes;
+
+void deviceMalloc(void** A, size_t bytes)
+{
+	cudaError_t cudaStatus = cudaMalloc(A, bytes);
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "cudaMalloc of " << bytes << " bytes failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	if (!*A)
+		return;
+	std::lock_guard<std::mutex> lock(device_mutex);
+	device_bytes[*A] = bytes;
+	allocated(MemoryTag::MODEL_DEVICE, bytes);
+}
+
+void deviceFree(void* A)
+{
+	if (!A)
+		return;
+	cudaFree(A);
+	std::lock_guard<std::mutex> lock(device_mutex);
+	auto iter = device_bytes.find(A);
+	if (iter != device_bytes.end())
+	{
+		freed(MemoryTag::MODEL_DEVICE, iter->second);
+		device_bytes.erase(iter);
+	}
+}
+
 void cudaSafeDeviceSynchronize()
 {
 	cudaError_t cudaStatus = cudaDeviceSynchronize();
@@ -50,7 +91,29 @@ __global__ void _matrixInitialize(float* A, int n, float r)
 		A[i] = 2.0f * (A[i] - 0.5f) * r;
 }
 
-__global__ void _matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+// 16-bit storage is either fp16 or bf16, the upper half of a float. Both are widened to float on load
+__device__ inline float load(const float* A, int i, bool bf16)
+{
+	return A[i];
+}
+
+__device__ inline float load(const unsigned short* A, int i, bool bf16)
+{
+	return bf16 ? __uint_as_float((unsigned int)A[i] << 16) : __half2float(__ushort_as_half(A[i]));
+}
+
+__device__ inline unsigned short store(float x, bool bf16)
+{
+	if (bf16)
+	{
+		unsigned int b = __float_as_uint(x);
+		return (unsigned short)((b + 0x7fff + ((b >> 16) & 1)) >> 16);
+	}
+	return __half_as_ushort(__float2half_rn(x));
+}
+
+template<typename TA, typename TB>
+__global__ void _matrixMultiply(float* C, const TA* A, int n0, int m0, const TB* B, int n1, int m1, bool bf16)
 {
 	
 	int i = blockIdx.y * blockDim.y + threadIdx.y;
@@ -71,9 +134,9 @@ __global__ void _matrixMultiply(float* C, float* A, int n0, int m0, float* B, in
 		int By = threadIdx.y + z * 32;
 		int Bx = j;
 		if (Ay < n0 && Ax < m0)
-			_A[threadIdx.y][threadIdx.x] = A[Ay + Ax * n0];
+			_A[threadIdx.y][threadIdx.x] = load(A, Ay + Ax * n0, bf16);
 		if (By < n1 && Bx < m1)
-			_B[threadIdx.y][threadIdx.x] = B[By + Bx * n1];
+			_B[threadIdx.y][threadIdx.x] = load(B, By + Bx * n1, bf16);
 
 		__syncthreads();
 
@@ -110,7 +173,8 @@ __global__ void _matrixMultiply(float* C, float* A, int n0, int m0, float* B, in
 	*/
 }
 
-__global__ void _matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+template<typename TA, typename TB>
+__global__ void _matrixMultiplyTranspose(float* C, const TA* A, int n0, int m0, const TB* B, int n1, int m1, bool bf16)
 {
 
 	int i = blockIdx.y * blockDim.y + threadIdx.y;
@@ -131,9 +195,9 @@ __global__ void _matrixMultiplyTranspose(float* C, float* A, int n0, int m0, flo
 		int By = threadIdx.y + z * 32;
 		int Bx = j;
 		if (Ay < n0 && Ax < m0)
-			_A[threadIdx.y][threadIdx.x] = A[Ay + Ax * n0];
+			_A[threadIdx.y][threadIdx.x] = load(A, Ay + Ax * n0, bf16);
 		if (By < n1 && Bx < m1)
-			_B[threadIdx.y][threadIdx.x] = B[By * m1 + Bx];
+			_B[threadIdx.y][threadIdx.x] = load(B, By * m1 + Bx, bf16);
 
 		__syncthreads();
 
@@ -178,16 +242,42 @@ __global__ void _matrixTranspose(float* B, float* A, int n, int m)
 		B[i * m + j] = A[j * n + i];
 }
 
-void matrixInitialize(float** A, int n, int m)
+// B[:, k] = A[:, cols[k]]
+__global__ void _matrixGatherCols(float* B, float* A, int n, int* cols, int size)
 {
-	cudaError_t cudaStatus = cudaMalloc(A, sizeof(float) * n * m);
-	if (cudaStatus != cudaSuccess)
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < size)
+		B[i] = A[cols[i / n] * n + i % n];
+}
+
+// B[:, cols[k]] = A[:, k]
+__global__ void _matrixScatterCols(float* B, float* A, int n, int* cols, int size)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < size)
+		B[cols[i / n] * n + i % n] = A[i];
+}
+
+// C[:, j] (+)= sum of A[:, cols[k]] for k in [offsets[j], offsets[j + 1])
+__global__ void _matrixSumCols(float* C, float* A, int n, int* offsets, int* cols, int size, bool accumulate)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < size)
 	{
-		std::cerr << "cudaMalloc failed: " << cudaGetErrorString(cudaStatus) << std::endl;
-		throw 0;
+		int j = i / n;
+		int row = i % n;
+		float sum = accumulate ? C[i] : 0.0f;
+		for (int k = offsets[j]; k < offsets[j + 1]; k++)
+			sum += A[cols[k] * n + row];
+		C[i] = sum;
 	}
 }
 
+void matrixInitialize(float** A, int n, int m)
+{
+	deviceMalloc((void**)A, sizeof(float) * n * m);
+}
+
 void matrixInitialize(float** A, int n, int m, float r)
 {
 	matrixInitialize(A, n, m);
@@ -238,12 +328,37 @@ void matrixFree(float** A)
 {
 	if (A)
 	{
-		cudaFree(*A);
+		deviceFree(*A);
 		*A = NULL;
 	}
 }
 
-void matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+void indexInitialize(int** A, int n)
+{
+	deviceMalloc((void**)A, sizeof(int) * n);
+}
+
+void indexFree(int** A)
+{
+	if (A)
+	{
+		deviceFree(*A);
+		*A = NULL;
+	}
+}
+
+void indexCopyToDevice(int* _A, int* A, int n)
+{
+	cudaError_t cudaStatus = cudaMemcpy(_A, A, sizeof(int) * n, cudaMemcpyHostToDevice);
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "cudaMemcpy failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+}
+
+template<typename TA, typename TB>
+void launchMatrixMultiply(float* C, TA* A, int n0, int m0, TB* B, int n1, int m1, bool bf16)
 {
 	if (m0 != n1)
 		throw 0;
@@ -251,7 +366,7 @@ void matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1
 	dim3 numThreads(32, 32);
 	dim3 numBlocks((m1 + 31) / 32, (n0 + 31) / 32);
 
-	_matrixMultiply<<<numBlocks, numThreads>>>(C, A, n0, m0, B, n1, m1);
+	_matrixMultiply<TA, TB><<<numBlocks, numThreads>>>(C, A, n0, m0, B, n1, m1, bf16);
 
 	cudaError_t cudaStatus = cudaGetLastError();
 	if (cudaStatus != cudaSuccess)
@@ -262,7 +377,8 @@ void matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1
 	cudaSafeDeviceSynchronize();
 }
 
-void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+template<typename TA, typename TB>
+void launchMatrixMultiplyTranspose(float* C, TA* A, int n0, int m0, TB* B, int n1, int m1, bool bf16)
 {
 	if (m0 != n1)
 		throw 0;
@@ -270,7 +386,7 @@ void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n
 	dim3 numThreads(32, 32);
 	dim3 numBlocks((m1 + 31) / 32, (n0 + 31) / 32);
 
-	_matrixMultiplyTranspose<<<numBlocks, numThreads>>>(C, A, n0, m0, B, n1, m1);
+	_matrixMultiplyTranspose<TA, TB><<<numBlocks, numThreads>>>(C, A, n0, m0, B, n1, m1, bf16);
 
 	cudaError_t cudaStatus = cudaGetLastError();
 	if (cudaStatus != cudaSuccess)
@@ -281,6 +397,55 @@ void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n
 	cudaSafeDeviceSynchronize();
 }
 
+void halfInitialize(unsigned short** A, int n, int m)
+{
+	deviceMalloc((void**)A, sizeof(unsigned short) * n * m);
+}
+
+void halfFree(unsigned short** A)
+{
+	if (A)
+	{
+		deviceFree(*A);
+		*A = NULL;
+	}
+}
+
+void halfCopyToDevice(unsigned short* _A, unsigned short* A, int n)
+{
+	cudaError_t cudaStatus = cudaMemcpy(_A, A, sizeof(unsigned short) * n, cudaMemcpyHostToDevice);
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "cudaMemcpy failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+}
+
+void matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+{
+	launchMatrixMultiply(C, A, n0, m0, B, n1, m1, false);
+}
+
+void matrixMultiply(float* C, float* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16)
+{
+	launchMatrixMultiply(C, A, n0, m0, B, n1, m1, bf16);
+}
+
+void matrixMultiply(float* C, unsigned short* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16)
+{
+	launchMatrixMultiply(C, A, n0, m0, B, n1, m1, bf16);
+}
+
+void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n1, int m1)
+{
+	launchMatrixMultiplyTranspose(C, A, n0, m0, B, n1, m1, false);
+}
+
+void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16)
+{
+	launchMatrixMultiplyTranspose(C, A, n0, m0, B, n1, m1, bf16);
+}
+
 void matrixTranspose(float* B, float* A, int n, int m)
 {
 	dim3 numThreads(32, 32);
@@ -297,6 +462,57 @@ void matrixTranspose(float* B, float* A, int n, int m)
 	cudaSafeDeviceSynchronize();
 }
 
+void matrixGatherCols(float* B, float* A, int n, int* cols, int m)
+{
+	if (n * m == 0)
+		return;
+
+	int numBlocks = (n * m + blockSize - 1) / blockSize;
+	_matrixGatherCols<<<numBlocks, blockSize>>>(B, A, n, cols, n * m);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_matrixGatherCols failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
+void matrixScatterCols(float* B, float* A, int n, int* cols, int m)
+{
+	if (n * m == 0)
+		return;
+
+	int numBlocks = (n * m + blockSize - 1) / blockSize;
+	_matrixScatterCols<<<numBlocks, blockSize>>>(B, A, n, cols, n * m);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_matrixScatterCols failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
+void matrixSumCols(float* C, float* A, int n, int* offsets, int* cols, int m, bool accumulate)
+{
+	if (n * m == 0)
+		return;
+
+	int numBlocks = (n * m + blockSize - 1) / blockSize;
+	_matrixSumCols<<<numBlocks, blockSize>>>(C, A, n, offsets, cols, n * m, accumulate);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_matrixSumCols failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
 __global__ void _arrayAdd(float* C, float* A, float* B, int n)
 {
 	int i = blockIdx.x * blockDim.x + threadIdx.x;
@@ -339,6 +555,13 @@ __global__ void _arrayMultiplyScalar(float* B, float* A, float b, int n)
 		B[i] = A[i] * b;
 }
 
+__global__ void _arrayMultiplyCols(float* C, float* A, float* B, int n, int height)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < n)
+		C[i] = A[i] * B[i / height];
+}
+
 __global__ void _arrayDivide(float* C, float* A, float* B, int n)
 {
 	int i = blockIdx.x * blockDim.x + threadIdx.x;
@@ -360,6 +583,30 @@ __global__ void _arrayDerivSigmoid(float* B, float* A, int n)
 		B[i] = A[i] * (1.0f - A[i]);
 }
 
+__global__ void _arrayToHalf(unsigned short* B, float* A, int n, bool bf16)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < n)
+		B[i] = store(A[i], bf16);
+}
+
+__global__ void _arraySigmoidHalf(unsigned short* B, float* A, float* bias, int n, int width, bool bf16)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < n)
+		B[i] = store(1.0f / (1.0f + expf(-(A[i] + bias[i % width]))), bf16);
+}
+
+__global__ void _arrayMultiplyDerivSigmoidHalf(float* C, float* A, unsigned short* B, int n, bool bf16)
+{
+	int i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i < n)
+	{
+		float b = load(B, i, bf16);
+		C[i] = A[i] * (b * (1.0f - b));
+	}
+}
+
 __global__ void _arrayReLU(float* B, float* A, int n)
 {
 	int i = blockIdx.x * blockDim.x + threadIdx.x;
@@ -485,6 +732,20 @@ void arrayMultiply(float* C, float* A, float b, int n)
 	cudaSafeDeviceSynchronize();
 }
 
+void arrayMultiplyCols(float* C, float* A, float* B, int n, int m)
+{
+	int numBlocks = (n * m + blockSize - 1) / blockSize;
+	_arrayMultiplyCols<<<numBlocks, blockSize>>>(C, A, B, n * m, n);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_arrayMultiplyCols failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
 void arrayDivide(float* C, float* A, float* B, int n)
 {
 	int numBlocks = (n + blockSize - 1) / blockSize;
@@ -567,4 +828,46 @@ void arraySqrt(float* B, float* A, int n)
 		throw 0;
 	}
 	cudaSafeDeviceSynchronize();
+}
+
+void arrayToHalf(unsigned short* B, float* A, int n, bool bf16)
+{
+	int numBlocks = (n + blockSize - 1) / blockSize;
+	_arrayToHalf<<<numBlocks, blockSize>>>(B, A, n, bf16);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_arrayToHalf failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
+void arraySigmoid(unsigned short* B, float* A, float* bias, int n, int m, bool bf16)
+{
+	int numBlocks = (n * m + blockSize - 1) / blockSize;
+	_arraySigmoidHalf<<<numBlocks, blockSize>>>(B, A, bias, n * m, n, bf16);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_arraySigmoidHalf failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
+}
+
+void arrayMultiplyDerivSigmoid(float* C, float* A, unsigned short* B, int n, bool bf16)
+{
+	int numBlocks = (n + blockSize - 1) / blockSize;
+	_arrayMultiplyDerivSigmoidHalf<<<numBlocks, blockSize>>>(C, A, B, n, bf16);
+
+	cudaError_t cudaStatus = cudaGetLastError();
+	if (cudaStatus != cudaSuccess)
+	{
+		std::cerr << "_arrayMultiplyDerivSigmoidHalf failed: " << cudaGetErrorString(cudaStatus) << std::endl;
+		throw 0;
+	}
+	cudaSafeDeviceSynchronize();
 }
\ No newline at end of file
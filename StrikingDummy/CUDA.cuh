@@ -10,12 +10,37 @@ void matrixInitialize(float** A, int n, int m, float r);
 
 void matrixFree(float** A);
 
+void indexInitialize(int** A, int n);
+
+void indexFree(int** A);
+
+void indexCopyToDevice(int* _A, int* A, int n);
+
+// 16-bit storage, fp16 or bf16 (bf16 = true). Kernels reading it accumulate in float
+void halfInitialize(unsigned short** A, int n, int m);
+
+void halfFree(unsigned short** A);
+
+void halfCopyToDevice(unsigned short* _A, unsigned short* A, int n);
+
 void matrixMultiply(float* C, float* A, int n0, int m0, float* B, int n1, int m1);
 
+void matrixMultiply(float* C, float* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16);
+
+void matrixMultiply(float* C, unsigned short* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16);
+
 void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, float* B, int n1, int m1);
 
+void matrixMultiplyTranspose(float* C, float* A, int n0, int m0, unsigned short* B, int n1, int m1, bool bf16);
+
 void matrixTranspose(float* B, float* A, int n, int m);
 
+void matrixGatherCols(float* B, float* A, int n, int* cols, int m);
+
+void matrixScatterCols(float* B, float* A, int n, int* cols, int m);
+
+void matrixSumCols(float* C, float* A, int n, int* offsets, int* cols, int m, bool accumulate);
+
 void arrayCopyToDevice(float* _A, float* A, int n);
 
 void arrayCopyToHost(float* A, float* _A, int n);
@@ -32,6 +57,8 @@ void arrayMultiply(float* C, float* A, float* B, int n);
 
 void arrayMultiply(float* C, float* A, float b, int n);
 
+void arrayMultiplyCols(float* C, float* A, float* B, int n, int m);
+
 void arrayDivide(float* C, float* A, float* B, int n);
 
 void arraySigmoid(float* B, float* A, int n);
@@ -42,4 +69,12 @@ void arrayReLU(float* B, float* A, int n);
 
 void arrayDerivReLU(float* B, float* A, int n);
 
-void arraySqrt(float* B, float* A, int n);
\ No newline at end of file
+void arraySqrt(float* B, float* A, int n);
+
+void arrayToHalf(unsigned short* B, float* A, int n, bool bf16);
+
+// B = sigmoid(A + bias[row]) for an n x m A, so the sums are read once and never written back
+void arraySigmoid(unsigned short* B, float* A, float* bias, int n, int m, bool bf16);
+
+// C = A * B * (1 - B), the sigmoid derivative taken straight from the 16 bit activations
+void arrayMultiplyDerivSigmoid(float* C, float* A, unsigned short* B, int n, bool bf16);
\ No newline at end of file
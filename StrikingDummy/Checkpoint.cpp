@@ -0,0 +1,273 @@
+#include "Checkpoint.h"
+#include "CUDA.cuh"
+#include "MappedFile.h"
+#include "Model.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace StrikingDummy
+{
+	namespace Checkpoint
+	{
+		static_assert(sizeof(Header) <= HEADER_SIZE, "checkpoint header does not fit");
+
+		const char CHECKPOINT_MAGIC[8] = { 'S', 'D', 'C', 'K', 'P', 'T', 0, 0 };
+
+		struct Tensor
+		{
+			float* device;
+			int size;
+			float* host;	// host mirror, NULL for optimizer state
+		};
+
+		static void get_tensors(Model& model, Tensor* tensors)
+		{
+			int W1_SIZE = INNER_1 * model.input_size;
+			int W2_SIZE = INNER_2 * INNER_1;
+			int W3_SIZE = model.output_size * INNER_2;
+
+			tensors[W1] = { model._W1, W1_SIZE, model.m_W1.data() };
+			tensors[W2] = { model._W2, W2_SIZE, model.m_W2.data() };
+			tensors[W3] = { model._W3, W3_SIZE, model.m_W3.data() };
+			tensors[B1] = { model._b1, INNER_1, model.m_b1.data() };
+			tensors[B2] = { model._b2, INNER_2, model.m_b2.data() };
+			tensors[B3] = { model._b3, model.output_size, model.m_b3.data() };
+			tensors[W1_M] = { model._dLdW1m, W1_SIZE, NULL };
+			tensors[W2_M] = { model._dLdW2m, W2_SIZE, NULL };
+			tensors[W3_M] = { model._dLdW3m, W3_SIZE, NULL };
+			tensors[B1_M] = { model._dLdb1m, INNER_1, NULL };
+			tensors[B2_M] = { model._dLdb2m, INNER_2, NULL };
+			tensors[B3_M] = { model._dLdb3m, model.output_size, NULL };
+			tensors[W1_V] = { model._dLdW1v, W1_SIZE, NULL };
+			tensors[W2_V] = { model._dLdW2v, W2_SIZE, NULL };
+			tensors[W3_V] = { model._dLdW3v, W3_SIZE, NULL };
+			tensors[B1_V] = { model._dLdb1v, INNER_1, NULL };
+			tensors[B2_V] = { model._dLdb2v, INNER_2, NULL };
+			tensors[B3_V] = { model._dLdb3v, model.output_size, NULL };
+		}
+
+		static uint64_t fnv1a(const char* data, size_t size)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= (unsigned char)data[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		static void write_string(std::string& out, const std::string& s)
+		{
+			uint32_t length = (uint32_t)s.size();
+			out.append((const char*)&length, sizeof(length));
+			out.append(s);
+		}
+
+		static bool read_string(const char*& p, const char* end, std::string& s)
+		{
+			uint32_t length;
+			if (end - p < (ptrdiff_t)sizeof(length))
+				return false;
+			memcpy(&length, p, sizeof(length));
+			p += sizeof(length);
+			if ((uint64_t)(end - p) < length)
+				return false;
+			s.assign(p, length);
+			p += length;
+			return true;
+		}
+
+		static std::string serialize(const TrainerState& trainer)
+		{
+			std::string out;
+			out.append((const char*)&trainer.epoch, sizeof(int));
+			out.append((const char*)&trainer.epoch_offset, sizeof(int));
+			out.append((const char*)&trainer.eps, sizeof(float));
+			out.append((const char*)&trainer.is_beta, sizeof(float));
+			out.append((const char*)&trainer.nu, sizeof(float));
+			write_string(out, trainer.rng);
+			write_string(out, trainer.rotation_rng);
+			write_string(out, trainer.job_rng);
+			out.append((const char*)&trainer.replay_index, sizeof(int));
+			out.append((const char*)&trainer.replay_size, sizeof(int));
+			return out;
+		}
+
+		static bool deserialize(const char* p, size_t size, TrainerState& trainer)
+		{
+			const char* end = p + size;
+			if (size < 3 * sizeof(float) + 2 * sizeof(int))
+				return false;
+			memcpy(&trainer.epoch, p, sizeof(int)); p += sizeof(int);
+			memcpy(&trainer.epoch_offset, p, sizeof(int)); p += sizeof(int);
+			memcpy(&trainer.eps, p, sizeof(float)); p += sizeof(float);
+			memcpy(&trainer.is_beta, p, sizeof(float)); p += sizeof(float);
+			memcpy(&trainer.nu, p, sizeof(float)); p += sizeof(float);
+			if (!read_string(p, end, trainer.rng) ||
+				!read_string(p, end, trainer.rotation_rng) ||
+				!read_string(p, end, trainer.job_rng))
+				return false;
+			// optional, older checkpoints end here
+			if (end - p >= (ptrdiff_t)(2 * sizeof(int)))
+			{
+				memcpy(&trainer.replay_index, p, sizeof(int)); p += sizeof(int);
+				memcpy(&trainer.replay_size, p, sizeof(int)); p += sizeof(int);
+			}
+			return true;
+		}
+
+		void save(const char* filename, Model& model, const TrainerState* trainer)
+		{
+			Tensor tensors[TRAINER];
+			get_tensors(model, tensors);
+
+			std::string trainer_bytes;
+			if (trainer)
+				trainer_bytes = serialize(*trainer);
+
+			Header header = {};
+			memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+			header.version = VERSION;
+			header.num_sections = NUM_SECTIONS;
+			header.input_size = model.input_size;
+			header.output_size = model.output_size;
+			header.inner_1 = INNER_1;
+			header.inner_2 = INNER_2;
+			header.beta1 = model.beta1;
+			header.beta2 = model.beta2;
+			header.adam = model.adam;
+
+			uint64_t offset = HEADER_SIZE;
+			for (int i = 0; i < NUM_SECTIONS; i++)
+			{
+				uint64_t size = i < TRAINER ? tensors[i].size * sizeof(float) : trainer_bytes.size();
+				header.sections[i] = { offset, size };
+				offset = (offset + size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+			}
+			header.file_size = offset;
+
+			std::vector<char> bytes(offset, 0);
+			for (int i = 0; i < TRAINER; i++)
+				arrayCopyToHost((float*)&bytes[header.sections[i].offset], tensors[i].device, tensors[i].size);
+			if (!trainer_bytes.empty())
+				memcpy(&bytes[header.sections[TRAINER].offset], trainer_bytes.data(), trainer_bytes.size());
+			header.checksum = fnv1a(&bytes[HEADER_SIZE], bytes.size() - HEADER_SIZE);
+			memcpy(bytes.data(), &header, sizeof(header));
+
+			// write next to the old checkpoint and replace it in one step, so a crash leaves either the
+			// old or the new checkpoint in place, never a torn or missing one
+			std::string temp = std::string(filename) + ".tmp";
+			std::fstream fs;
+			fs.open(temp, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+			fs.write(bytes.data(), bytes.size());
+			fs.close();
+			if (!fs)
+			{
+				std::cerr << "Writing checkpoint " << temp << " failed" << std::endl;
+				return;
+			}
+#ifdef _WIN32
+			bool replaced = MoveFileExA(temp.c_str(), filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			bool replaced = std::rename(temp.c_str(), filename) == 0;
+#endif
+			if (!replaced)
+				std::cerr << "Renaming " << temp << " to " << filename << " failed" << std::endl;
+		}
+
+		static bool fail(const char* filename, const char* reason)
+		{
+			std::cerr << "Checkpoint " << filename << ": " << reason << std::endl;
+			return false;
+		}
+
+		static bool load_legacy(const char* filename, const char* data, size_t size, Tensor* tensors)
+		{
+			size_t expected = 0;
+			for (int i = W1; i <= B3; i++)
+				expected += tensors[i].size * sizeof(float);
+			if (size != expected)
+				return fail(filename, "not a checkpoint");
+
+			for (int i = W1; i <= B3; i++)
+			{
+				memcpy(tensors[i].host, data, tensors[i].size * sizeof(float));
+				arrayCopyToDevice(tensors[i].device, tensors[i].host, tensors[i].size);
+				data += tensors[i].size * sizeof(float);
+			}
+			return true;
+		}
+
+		bool load(const char* filename, Model& model, TrainerState* trainer)
+		{
+			MappedFile file;
+			if (!file.open(filename, false))
+				return false;
+
+			Tensor tensors[TRAINER];
+			get_tensors(model, tensors);
+
+			const char* data = (const char*)file.data;
+			const Header* header = (const Header*)data;
+
+			if (file.size < HEADER_SIZE || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+			{
+				if (!load_legacy(filename, data, file.size, tensors))
+					return false;
+				model.inference.set_weights(model.m_W1, model.m_W2, model.m_W3, model.m_b1, model.m_b2, model.m_b3);
+				return true;
+			}
+
+			if (header->version != VERSION || header->num_sections != NUM_SECTIONS)
+				return fail(filename, "unsupported version");
+			if (header->input_size != model.input_size || header->output_size != model.output_size ||
+				header->inner_1 != INNER_1 || header->inner_2 != INNER_2)
+				return fail(filename, "layer shapes do not match the model");
+			if ((header->adam != 0) != model.adam)
+				return fail(filename, "optimizer does not match the model");
+			if (header->file_size != file.size)
+				return fail(filename, "truncated");
+			for (int i = 0; i < NUM_SECTIONS; i++)
+			{
+				const SectionEntry& section = header->sections[i];
+				if (section.offset < HEADER_SIZE || section.offset % SECTION_ALIGNMENT != 0 ||
+					section.offset > file.size || section.size > file.size - section.offset ||
+					(i < TRAINER && section.size != tensors[i].size * sizeof(float)))
+					return fail(filename, "corrupt section table");
+			}
+			if (fnv1a(data + HEADER_SIZE, file.size - HEADER_SIZE) != header->checksum)
+				return fail(filename, "checksum mismatch");
+
+			// straight from the mapping, no staging buffer
+			for (int i = 0; i < TRAINER; i++)
+			{
+				const float* section = (const float*)(data + header->sections[i].offset);
+				arrayCopyToDevice(tensors[i].device, (float*)section, tensors[i].size);
+				if (tensors[i].host)
+					memcpy(tensors[i].host, section, tensors[i].size * sizeof(float));
+			}
+			model.beta1 = header->beta1;
+			model.beta2 = header->beta2;
+			model.inference.set_weights(model.m_W1, model.m_W2, model.m_W3, model.m_b1, model.m_b2, model.m_b3);
+
+			const SectionEntry& state = header->sections[TRAINER];
+			if (trainer && state.size > 0)
+			{
+				TrainerState loaded;
+				if (!deserialize(data + state.offset, state.size, loaded))
+					return fail(filename, "corrupt trainer state");
+				*trainer = loaded;
+			}
+			return true;
+		}
+	}
+}
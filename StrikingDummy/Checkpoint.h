@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace StrikingDummy
+{
+	struct Model;
+
+	// Where train() was when a checkpoint was written. RNG states are kept in their
+	// std::mt19937 text form, which is portable between standard libraries.
+	struct TrainerState
+	{
+		int epoch = 0;
+		int epoch_offset = 0;
+		float eps = 1.0f;
+		float is_beta = 0.0f;
+		float nu = 0.0f;
+		std::string rng;
+		std::string rotation_rng;
+		std::string job_rng;
+		// write position of the replay memory, -1 in checkpoints written before it was recorded
+		int replay_index = -1;
+		int replay_size = -1;
+	};
+
+	// Checkpoint file layout: a HEADER_SIZE header followed by one SECTION_ALIGNMENT aligned
+	// section per tensor (weights, then Adam first and second moments) and the trainer state.
+	// Sections are read straight out of a read-only mapping of the file.
+	namespace Checkpoint
+	{
+		enum Section
+		{
+			W1, W2, W3, B1, B2, B3,
+			W1_M, W2_M, W3_M, B1_M, B2_M, B3_M,
+			W1_V, W2_V, W3_V, B1_V, B2_V, B3_V,
+			TRAINER,
+			NUM_SECTIONS
+		};
+
+		struct SectionEntry
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t num_sections;
+			int32_t input_size;
+			int32_t output_size;
+			int32_t inner_1;
+			int32_t inner_2;
+			float beta1;
+			float beta2;
+			uint32_t adam;
+			uint32_t reserved;
+			uint64_t file_size;
+			uint64_t checksum;	// FNV-1a over everything after the header
+			SectionEntry sections[NUM_SECTIONS];
+		};
+
+		static constexpr uint32_t VERSION = 1;
+		static constexpr int HEADER_SIZE = 4096;
+		static constexpr int SECTION_ALIGNMENT = 64;
+
+		// trainer may be NULL for a weights-only checkpoint
+		void save(const char* filename, Model& model, const TrainerState* trainer);
+
+		// also accepts the old headerless W1..b3 dumps. Returns false if nothing was loaded,
+		// and leaves trainer untouched if the file has no trainer state
+		bool load(const char* filename, Model& model, TrainerState* trainer);
+	}
+}
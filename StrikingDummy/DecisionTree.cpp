@@ -0,0 +1,261 @@
+#include "DecisionTree.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+
+namespace StrikingDummy
+{
+	struct DecisionTree::Builder
+	{
+		DecisionTree& tree;
+		const std::vector<int>& labels;
+		const std::vector<unsigned int>& legal;
+		int num_samples;
+		std::vector<std::vector<float>> thresholds;	// per feature, ascending
+		std::vector<unsigned char> bins;			// per sample and feature, index of the first threshold >= value
+		std::vector<int> global_counts;
+
+		Builder(DecisionTree& tree, const std::vector<float>& states, const std::vector<int>& labels, const std::vector<unsigned int>& legal) :
+			tree(tree), labels(labels), legal(legal), num_samples((int)labels.size())
+		{
+			int F = tree.num_features;
+			thresholds.resize(F);
+			bins.resize((size_t)num_samples * F);
+
+			std::vector<float> values(num_samples);
+			std::vector<float> distinct;
+			for (int f = 0; f < F; f++)
+			{
+				for (int i = 0; i < num_samples; i++)
+					values[i] = states[(size_t)i * F + f];
+				std::sort(values.begin(), values.end());
+				distinct.clear();
+				std::unique_copy(values.begin(), values.end(), std::back_inserter(distinct));
+
+				// few distinct values (the flags): split between each of them, otherwise at quantiles.
+				// constant features get no thresholds and are never tested
+				std::vector<float>& t = thresholds[f];
+				if ((int)distinct.size() <= tree.max_bins)
+				{
+					for (size_t i = 1; i < distinct.size(); i++)
+						t.push_back(0.5f * (distinct[i - 1] + distinct[i]));
+				}
+				else
+				{
+					for (int b = 1; b < tree.max_bins; b++)
+						t.push_back(values[(size_t)num_samples * b / tree.max_bins]);
+					t.erase(std::unique(t.begin(), t.end()), t.end());
+					if (t.back() >= distinct.back())
+						t.pop_back();
+				}
+
+				for (int i = 0; i < num_samples; i++)
+				{
+					float x = states[(size_t)i * F + f];
+					bins[(size_t)i * F + f] = (unsigned char)(std::lower_bound(t.begin(), t.end(), x) - t.begin());
+				}
+			}
+
+			global_counts.assign(tree.num_actions, 0);
+			for (int label : labels)
+				global_counts[label]++;
+		}
+
+		// n times the gini impurity of a set with these label counts
+		static float impurity(const int* counts, int num_actions, int n)
+		{
+			if (n == 0)
+				return 0.0f;
+			long long sum = 0;
+			for (int a = 0; a < num_actions; a++)
+				sum += (long long)counts[a] * counts[a];
+			return n - (float)sum / n;
+		}
+
+		// greedy ranking: the action chosen most often goes first, then every sample that could have used it
+		// is settled (the tree would pick it there) and the next action is ranked on what is left
+		int make_leaf(int* begin, int* end)
+		{
+			int A = tree.num_actions;
+			std::vector<int> counts(A);
+			std::vector<bool> ranked(A, false);
+			std::vector<int> order;
+			while ((int)order.size() < A)
+			{
+				std::fill(counts.begin(), counts.end(), 0);
+				for (int* i = begin; i < end; i++)
+					counts[labels[*i]]++;
+				int best = -1;
+				for (int a = 0; a < A; a++)
+				{
+					if (ranked[a])
+						continue;
+					// actions never chosen here fall back on how often they were chosen anywhere
+					if (best < 0 || counts[a] > counts[best] || (counts[a] == counts[best] && global_counts[a] > global_counts[best]))
+						best = a;
+				}
+				ranked[best] = true;
+				order.push_back(best);
+				end = std::partition(begin, end, [&](int i) { return (legal[i] & (1u << best)) == 0; });
+			}
+
+			int node = (int)tree.nodes.size();
+			tree.nodes.push_back({ -1, 0.0f, (int)tree.rankings.size(), -1 });
+			for (int action : order)
+				tree.rankings.push_back((unsigned char)action);
+			return node;
+		}
+
+		int build(int* begin, int* end, int depth)
+		{
+			int F = tree.num_features;
+			int A = tree.num_actions;
+			int n = (int)(end - begin);
+
+			std::vector<int> counts(A, 0);
+			for (int* i = begin; i < end; i++)
+				counts[labels[*i]]++;
+			float parent = impurity(counts.data(), A, n);
+			if (depth >= tree.max_depth || n < 2 * tree.min_leaf || parent <= 0.0f)
+				return make_leaf(begin, end);
+
+			int best_feature = -1;
+			int best_bin = 0;
+			float best_impurity = parent - 1e-3f;
+
+			std::vector<int> hist;
+			std::vector<int> left(A);
+			std::vector<int> right(A);
+			for (int f = 0; f < F; f++)
+			{
+				int T = (int)thresholds[f].size();
+				if (T == 0)
+					continue;
+				hist.assign((size_t)(T + 1) * A, 0);
+				for (int* i = begin; i < end; i++)
+					hist[bins[(size_t)*i * F + f] * A + labels[*i]]++;
+
+				std::fill(left.begin(), left.end(), 0);
+				int n_left = 0;
+				for (int b = 0; b < T; b++)
+				{
+					for (int a = 0; a < A; a++)
+					{
+						left[a] += hist[b * A + a];
+						n_left += hist[b * A + a];
+					}
+					int n_right = n - n_left;
+					if (n_left < tree.min_leaf)
+						continue;
+					if (n_right < tree.min_leaf)
+						break;
+					for (int a = 0; a < A; a++)
+						right[a] = counts[a] - left[a];
+					float split = impurity(left.data(), A, n_left) + impurity(right.data(), A, n_right);
+					if (split < best_impurity)
+					{
+						best_impurity = split;
+						best_feature = f;
+						best_bin = b;
+					}
+				}
+			}
+
+			if (best_feature < 0)
+				return make_leaf(begin, end);
+
+			int* middle = std::partition(begin, end, [&](int i) { return bins[(size_t)i * F + best_feature] <= best_bin; });
+
+			int node = (int)tree.nodes.size();
+			tree.nodes.push_back({ best_feature, thresholds[best_feature][best_bin], -1, -1 });
+			int l = build(begin, middle, depth + 1);
+			int r = build(middle, end, depth + 1);
+			tree.nodes[node].left = l;
+			tree.nodes[node].right = r;
+			return node;
+		}
+	};
+
+	void DecisionTree::fit(const std::vector<float>& states, const std::vector<int>& labels, const std::vector<unsigned int>& legal, int num_features, int num_actions)
+	{
+		this->num_features = num_features;
+		this->num_actions = num_actions;
+		nodes.clear();
+		rankings.clear();
+
+		Builder builder(*this, states, labels, legal);
+		std::vector<int> samples(labels.size());
+		std::iota(samples.begin(), samples.end(), 0);
+		builder.build(samples.data(), samples.data() + samples.size(), 0);
+	}
+
+	int DecisionTree::depth() const
+	{
+		std::vector<int> depths(nodes.size(), 0);
+		int max_depth = 0;
+		// children are always stored after their parent
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			max_depth = std::max(max_depth, depths[i]);
+			if (nodes[i].feature >= 0)
+				depths[nodes[i].left] = depths[nodes[i].right] = depths[i] + 1;
+		}
+		return max_depth;
+	}
+
+	int DecisionTree::leaves() const
+	{
+		return (int)std::count_if(nodes.begin(), nodes.end(), [](const Node& node) { return node.feature < 0; });
+	}
+
+	bool DecisionTree::load(const char* filename)
+	{
+		std::fstream fs;
+		fs.open(filename, std::fstream::in);
+		if (!fs.is_open())
+			return false;
+
+		int num_nodes;
+		fs >> num_features >> num_actions >> num_nodes;
+		nodes.resize(num_nodes);
+		rankings.clear();
+		for (Node& node : nodes)
+		{
+			fs >> node.feature >> node.threshold >> node.left >> node.right;
+			if (node.feature >= 0)
+				continue;
+			node.left = (int)rankings.size();
+			for (int i = 0; i < num_actions; i++)
+			{
+				int action;
+				fs >> action;
+				rankings.push_back((unsigned char)action);
+			}
+		}
+		if (!fs)
+		{
+			std::cerr << "Failed to read decision tree " << filename << std::endl;
+			nodes.clear();
+			return false;
+		}
+		return true;
+	}
+
+	void DecisionTree::save(const char* filename) const
+	{
+		std::fstream fs;
+		fs.open(filename, std::fstream::out | std::fstream::trunc);
+		fs.precision(9);
+		fs << num_features << " " << num_actions << " " << nodes.size() << "\n";
+		for (const Node& node : nodes)
+		{
+			fs << node.feature << " " << node.threshold << " " << node.left << " " << node.right;
+			if (node.feature < 0)
+				for (int i = 0; i < num_actions; i++)
+					fs << " " << (int)rankings[node.left + i];
+			fs << "\n";
+		}
+	}
+}
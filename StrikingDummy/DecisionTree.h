@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Classification tree distilled from a trained policy. Inner nodes test one state feature against a
+	// threshold, leaves hold every action ranked by how often the policy chose it there, so the first
+	// usable action in the ranking is the decision.
+	struct DecisionTree
+	{
+		struct Node
+		{
+			int feature;		// -1 for leaves
+			float threshold;	// state[feature] <= threshold goes left
+			int left;			// leaves: offset of the ranking in rankings
+			int right;
+		};
+
+		int max_depth = 14;
+		int min_leaf = 16;		// fewest samples on either side of a split
+		int max_bins = 32;		// candidate thresholds per feature, taken at quantiles of the samples
+
+		int num_features = 0;
+		int num_actions = 0;
+		std::vector<Node> nodes;
+		std::vector<unsigned char> rankings;
+
+		// states holds one row of num_features floats per sample, labels the action the policy chose and
+		// legal the usable actions (bit i set <=> action i is usable), which is what the rankings are fit to
+		void fit(const std::vector<float>& states, const std::vector<int>& labels, const std::vector<unsigned int>& legal, int num_features, int num_actions);
+
+		// legal: bit i set <=> action i is usable
+		int select(const float* state, unsigned int legal) const
+		{
+			const Node* node = &nodes[0];
+			while (node->feature >= 0)
+				node = &nodes[state[node->feature] <= node->threshold ? node->left : node->right];
+			const unsigned char* ranking = &rankings[node->left];
+			for (int i = 0; i < num_actions; i++)
+				if (legal & (1u << ranking[i]))
+					return ranking[i];
+			return -1;
+		}
+
+		int select(const float* state, const std::vector<int>& actions) const
+		{
+			unsigned int legal = 0;
+			for (int action : actions)
+				legal |= 1u << action;
+			return select(state, legal);
+		}
+
+		int depth() const;
+		int leaves() const;
+
+		bool load(const char* filename);
+		void save(const char* filename) const;
+
+	private:
+		struct Builder;
+	};
+}
@@ -0,0 +1,168 @@
+#include "Evaluator.h"
+#include "BlackMage.h"
+#include "InferenceQueue.h"
+#include "Parallel.h"
+#include "Rotation.h"
+#include <chrono>
+#include <memory>
+#include <sstream>
+
+namespace StrikingDummy
+{
+	std::string Evaluation::summary(Job& job) const
+	{
+		std::stringstream ss;
+		ss.precision(6);
+		ss << "dps: " << dps.mean << " +/- " << dps.ci95() << " (" << dps.count << " fights)";
+		ss.precision(4);
+		for (int action = 1; action < (int)action_counts.size(); action++)
+			if (action_counts[action] > 0.0f)
+				ss << ", " << job.get_action_name(action) << ": " << action_counts[action];
+		if (metrics.fights > 0)
+		{
+			double total = metrics.total_damage();
+			for (int action = 0; action < (int)metrics.casts.size(); action++)
+				if (metrics.damage[action] + metrics.tick_damage[action] > 0.0)
+					ss << ", " << metrics.action_names[action] << " damage: " << 100.0 * (metrics.damage[action] + metrics.tick_damage[action]) / total << "%";
+		}
+		return ss.str();
+	}
+
+	std::string PairedEvaluation::summary() const
+	{
+		std::stringstream ss;
+		ss.precision(6);
+		ss << "a: " << a.mean << " +/- " << a.ci95() << ", b: " << b.mean << " +/- " << b.ci95();
+		ss << ", b - a: " << difference.mean << " +/- " << difference.ci95() << " (" << difference.count << " paired fights";
+		ss.precision(3);
+		if (efficiency() > 0.0)
+			ss << ", " << efficiency() << "x as efficient as unpaired";
+		ss << ")";
+		return ss.str();
+	}
+
+	static void run_fight(BlackMage& blm, Model& model, InferenceQueue* queue, unsigned int seed, int fight_seconds)
+	{
+		blm.rng.seed(seed);
+		BlackMageRotation rotation(blm, model);
+		rotation.queue = queue;
+		rotation.reset(0.0f, 0.0f);
+
+		blm.reset();
+		while (blm.timeline.time < fight_seconds * 1000)
+			rotation.step();
+	}
+
+	PairedEvaluation compare(const Stats& stats_a, const Inference& a, const Stats& stats_b, const Inference& b, int fights, int fight_seconds, int num_threads)
+	{
+		// only inference is used, nothing is allocated on the device
+		Model model_a, model_b;
+		model_a.inference = a;
+		model_b.inference = b;
+
+		std::vector<float> dps_a(fights);
+		std::vector<float> dps_b(fights);
+		parallel_for(fights, [&](int fight)
+		{
+			Stats job_stats_a = stats_a;
+			BlackMage blm_a(job_stats_a);
+			run_fight(blm_a, model_a, NULL, fight, fight_seconds);
+			dps_a[fight] = 1000.0f * blm_a.total_damage / blm_a.timeline.time;
+
+			Stats job_stats_b = stats_b;
+			BlackMage blm_b(job_stats_b);
+			run_fight(blm_b, model_b, NULL, fight, fight_seconds);
+			dps_b[fight] = 1000.0f * blm_b.total_damage / blm_b.timeline.time;
+		}, num_threads);
+
+		PairedEvaluation result;
+		for (int fight = 0; fight < fights; fight++)
+		{
+			result.a.add(dps_a[fight]);
+			result.b.add(dps_b[fight]);
+			result.difference.add(dps_b[fight] - dps_a[fight]);
+		}
+		return result;
+	}
+
+	Evaluator::Evaluator(const Stats& stats, int fights, int fight_seconds, int num_threads) :
+		stats(stats), fights(fights), fight_seconds(fight_seconds), num_threads(num_threads)
+	{
+
+	}
+
+	Evaluator::~Evaluator()
+	{
+		if (pending.valid())
+			pending.wait();
+	}
+
+	bool Evaluator::start(const Inference& inference, int epoch)
+	{
+		if (pending.valid())
+			return false;
+		snapshot.inference = inference;
+		pending = std::async(std::launch::async, &Evaluator::run, this, epoch);
+		return true;
+	}
+
+	bool Evaluator::poll(Evaluation& result)
+	{
+		if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		result = pending.get();
+		return true;
+	}
+
+	Evaluation Evaluator::wait()
+	{
+		return pending.get();
+	}
+
+	Evaluation Evaluator::run(int epoch)
+	{
+		std::vector<float> dps(fights);
+		std::vector<std::vector<int>> counts(fights);
+		std::vector<Metrics> fight_metrics(Metrics::enabled ? fights : 0);
+
+		// every thread has at most one decision outstanding, so a batch is full once each busy thread has
+		// asked, and busy threads are the fights not finished yet up to the thread count. A single
+		// thread has nothing to batch with and calls the network directly.
+		int threads = thread_count(fights, num_threads);
+		std::unique_ptr<InferenceQueue> queue;
+		if (threads > 1)
+		{
+			queue.reset(new InferenceQueue(snapshot.inference, threads));
+			queue->set_producers(threads);
+		}
+		std::atomic<int> remaining(fights);
+
+		parallel_for(fights, [&](int fight)
+		{
+			Stats job_stats = stats;
+			BlackMage blm(job_stats);
+			run_fight(blm, snapshot, queue.get(), fight, fight_seconds);
+			if (queue)
+				queue->set_producers(std::min(threads, --remaining));
+
+			dps[fight] = 1000.0f * blm.total_damage / blm.timeline.time;
+			counts[fight].assign(blm.get_num_actions(), 0);
+			for (Transition& t : blm.history)
+				counts[fight][t.action]++;
+			METRIC(fight_metrics[fight] = blm.metrics);
+		}, threads);
+
+		Evaluation result;
+		result.epoch = epoch;
+		result.action_counts.assign(counts.empty() ? 0 : counts[0].size(), 0.0f);
+		for (int fight = 0; fight < fights; fight++)
+		{
+			result.dps.add(dps[fight]);
+			for (int action = 0; action < (int)counts[fight].size(); action++)
+				result.action_counts[action] += (float)counts[fight][action] / fights;
+		}
+		for (const Metrics& metrics : fight_metrics)
+			result.metrics.merge(metrics);
+		return result;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Job.h"
+#include "Metrics.h"
+#include "Model.h"
+#include "Statistics.h"
+#include <future>
+#include <string>
+#include <vector>
+
+namespace StrikingDummy
+{
+	struct Evaluation
+	{
+		int epoch = 0;
+		RunningStat dps;
+		std::vector<float> action_counts;	// mean uses of each action per fight
+		Metrics metrics;					// all fights merged, SD_METRICS builds only
+
+		std::string summary(Job& job) const;
+	};
+
+	// Two candidates, each a policy and stats, over the same fights. Fight i gives both of them the server
+	// ticks and proc streams of seed i, so most of the fight to fight noise cancels in the difference.
+	struct PairedEvaluation
+	{
+		RunningStat a;
+		RunningStat b;
+		RunningStat difference;		// b - a, fight by fight
+
+		// fights an unpaired comparison would need for the same confidence interval, per paired fight
+		double efficiency() const { return difference.variance() > 0.0 ? (a.variance() + b.variance()) / difference.variance() : 0.0; }
+		std::string summary() const;
+	};
+
+	PairedEvaluation compare(const Stats& stats_a, const Inference& a, const Stats& stats_b, const Inference& b, int fights, int fight_seconds, int num_threads = 0);
+
+	// Runs seeded fights against a snapshot of the policy on background threads, so training never
+	// waits on evaluation. Fight i always uses seed i, which keeps evaluations of different epochs comparable.
+	struct Evaluator
+	{
+		Stats stats;
+		int fights;
+		int fight_seconds;
+		int num_threads;
+
+		Evaluator(const Stats& stats, int fights, int fight_seconds, int num_threads = 0);
+		~Evaluator();
+
+		bool busy() const { return pending.valid(); }
+
+		// returns false without doing anything while the previous evaluation is still running
+		bool start(const Inference& inference, int epoch);
+
+		// true once per evaluation, when it has finished
+		bool poll(Evaluation& result);
+		Evaluation wait();
+
+	private:
+		Model snapshot;		// only inference is used, nothing is allocated on the device
+		std::future<Evaluation> pending;
+
+		Evaluation run(int epoch);
+	};
+}
@@ -0,0 +1,185 @@
+#include "GearOptimizer.h"
+#include "ActionScript.h"
+#include "BlackMage.h"
+#include "InferenceQueue.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "Rotation.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <tuple>
+
+namespace StrikingDummy
+{
+	void GearOptimizer::enumerate(const GearSpace& space)
+	{
+		candidates.clear();
+
+		// sets that land on the same tier of every substat play out identically
+		std::set<std::tuple<float, float, float, float, float, float>> tiers;
+
+		for (int crit = space.min[GearSpace::CRIT]; crit <= space.max[GearSpace::CRIT]; crit += space.step)
+		{
+			for (int dh = space.min[GearSpace::DH]; dh <= space.max[GearSpace::DH]; dh += space.step)
+			{
+				for (int det = space.min[GearSpace::DET]; det <= space.max[GearSpace::DET]; det += space.step)
+				{
+					int ss = space.budget - crit - dh - det;
+					if (ss < space.min[GearSpace::SS] || ss > space.max[GearSpace::SS])
+						continue;
+
+					GearCandidate candidate;
+					candidate.stats = space.base;
+					candidate.stats.critical_hit = crit;
+					candidate.stats.direct_hit = dh;
+					candidate.stats.determination = det;
+					candidate.stats.skill_speed = ss;
+
+					Stats derived = candidate.stats;
+					derived.calculate_stats(BlackMage::BLM_ATTR);
+					auto tier = std::make_tuple(derived.crit_rate, derived.crit_multiplier, derived.dhit_rate, derived.det_multiplier, derived.ss_multiplier, derived.dot_multiplier);
+					if (tiers.insert(tier).second)
+						candidates.push_back(candidate);
+				}
+			}
+		}
+	}
+
+	void GearOptimizer::evaluate(std::vector<GearCandidate*>& pool, int fights)
+	{
+		// split each candidate's fights into tasks so a handful of finalists still fill every core
+		int tasks_per_candidate = (fights + fights_per_task - 1) / fights_per_task;
+		int num_tasks = pool.size() * tasks_per_candidate;
+		std::vector<RunningStat> partials(num_tasks);
+
+		// the tasks share one batching queue, see Evaluator::run
+		int threads = thread_count(num_tasks, num_threads);
+		std::unique_ptr<InferenceQueue> queue;
+		if (threads > 1)
+		{
+			queue.reset(new InferenceQueue(model.inference, threads));
+			queue->set_producers(threads);
+		}
+		std::atomic<int> remaining(num_tasks);
+
+		parallel_for(num_tasks, [&](int task)
+		{
+			GearCandidate& candidate = *pool[task / tasks_per_candidate];
+			int first = (task % tasks_per_candidate) * fights_per_task;
+			int count = std::min(fights_per_task, fights - first);
+
+			Stats stats = candidate.stats;
+			BlackMage blm(stats);
+			blm.rng.seed(task);
+			BlackMageRotation rotation(blm, model);
+			rotation.queue = queue.get();
+			rotation.reset(0.0f, 0.0f);
+
+			int time = fight_seconds * 1000;
+			for (int i = 0; i < count; i++)
+			{
+				blm.reset();
+				while (blm.timeline.time < time)
+					rotation.step();
+				partials[task].add(1000.0 * blm.total_damage / blm.timeline.time);
+			}
+			if (queue)
+				queue->set_producers(std::min(threads, --remaining));
+		}, threads);
+
+		// merged in task order so the result does not depend on scheduling
+		for (int task = 0; task < num_tasks; task++)
+			pool[task / tasks_per_candidate]->dps.merge(partials[task]);
+	}
+
+	void GearOptimizer::report(std::vector<GearCandidate*>& pool)
+	{
+		std::sort(pool.begin(), pool.end(), [](const GearCandidate* a, const GearCandidate* b)
+		{
+			return a->dps.mean > b->dps.mean;
+		});
+
+		std::stringstream ss;
+		ss.precision(6);
+		for (int i = 0; i < (int)pool.size(); i++)
+		{
+			const GearCandidate& c = *pool[i];
+			ss << i + 1 << ". crit: " << c.stats.critical_hit << ", dh: " << c.stats.direct_hit << ", det: " << c.stats.determination << ", ss: " << c.stats.skill_speed;
+			ss << ", dps: " << c.dps.mean << " +/- " << c.dps.ci95() << " (" << c.dps.count << " fights)" << std::endl;
+		}
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+	}
+
+	void GearOptimizer::run(const GearSpace& space, const char* weights)
+	{
+		Stats base = space.base;
+		BlackMage blm(base);
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		model.load(weights);
+
+		enumerate(space);
+		std::cout << candidates.size() << " distinct gear sets" << std::endl;
+
+		std::vector<GearCandidate*> pool;
+		for (GearCandidate& c : candidates)
+			pool.push_back(&c);
+		evaluate(pool, screen_fights);
+		std::sort(pool.begin(), pool.end(), [](const GearCandidate* a, const GearCandidate* b)
+		{
+			return a->dps.mean > b->dps.mean;
+		});
+
+		// anything the best set does not clearly beat goes on to the full runs
+		double cutoff = pool.front()->dps.mean - pool.front()->dps.ci95();
+		std::vector<GearCandidate*> finalists;
+		for (GearCandidate* c : pool)
+		{
+			if ((int)finalists.size() == max_finalists || c->dps.mean + c->dps.ci95() < cutoff)
+				break;
+			c->dps = RunningStat();
+			finalists.push_back(c);
+		}
+		std::cout << finalists.size() << " sets after screening" << std::endl;
+
+		evaluate(finalists, full_fights);
+		report(finalists);
+
+		Logger::close();
+	}
+
+	void GearOptimizer::rescore(const GearSpace& space, const char* script)
+	{
+		ActionScript recording;
+		if (!recording.load(script))
+			return;
+
+		enumerate(space);
+		std::vector<Stats> stats;
+		for (GearCandidate& c : candidates)
+			stats.push_back(c.stats);
+		std::vector<ReplayResult> results = recording.replay(stats, num_threads);
+
+		std::vector<int> order(candidates.size());
+		for (int i = 0; i < (int)order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return results[a].dps() > results[b].dps(); });
+
+		std::stringstream ss;
+		ss.precision(6);
+		ss << candidates.size() << " distinct gear sets replayed on " << recording.steps.size() << " steps" << std::endl;
+		for (int i = 0; i < (int)order.size() && i < max_finalists; i++)
+		{
+			const GearCandidate& c = candidates[order[i]];
+			const ReplayResult& r = results[order[i]];
+			ss << i + 1 << ". crit: " << c.stats.critical_hit << ", dh: " << c.stats.direct_hit << ", det: " << c.stats.determination << ", ss: " << c.stats.skill_speed;
+			ss << ", dps: " << r.dps() << ", illegal steps: " << r.illegal.size() << ", waited: " << r.wait / 1000.0 << "s" << std::endl;
+		}
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+
+		Logger::close();
+	}
+}
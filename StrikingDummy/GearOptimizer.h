@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Job.h"
+#include "Model.h"
+#include "Statistics.h"
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Substat allocations to search: every split of budget between crit, direct hit, determination and
+	// skill speed on a grid of step points (a whole number of materia) within per-substat bounds.
+	// Weapon damage and main stat come from base.
+	struct GearSpace
+	{
+		enum { CRIT, DH, DET, SS, NUM_SUBSTATS };
+
+		Stats base;
+		int budget;
+		int step;
+		int min[NUM_SUBSTATS];
+		int max[NUM_SUBSTATS];
+	};
+
+	struct GearCandidate
+	{
+		Stats stats;
+		RunningStat dps;
+	};
+
+	// Ranks gear sets by the DPS a trained policy gets out of them. Every candidate gets a short
+	// screening run, and only those whose confidence interval reaches the best one go on to full runs.
+	struct GearOptimizer
+	{
+		int screen_fights = 8;
+		int full_fights = 256;
+		int max_finalists = 32;
+		int fight_seconds = 600;
+		int fights_per_task = 8;
+		int num_threads = 0;	// all cores
+
+		Model model;
+		std::vector<GearCandidate> candidates;
+
+		void enumerate(const GearSpace& space);
+		void run(const GearSpace& space, const char* weights);
+
+		// scores every candidate on one recorded fight (see ActionScript) instead of running the policy
+		void rescore(const GearSpace& space, const char* script);
+
+	private:
+		void evaluate(std::vector<GearCandidate*>& pool, int fights);
+		void report(std::vector<GearCandidate*>& pool);
+	};
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace StrikingDummy
+{
+	// Storage precision of the training batch path. Reduced precisions keep 16 bits per value and are
+	// widened to float wherever they are read, so sums stay in fp32 and master weights are fp32 throughout.
+	enum class Precision
+	{
+		FP32,
+		FP16,
+		BF16	// upper half of a float: fp32 range, 8 bits of mantissa
+	};
+
+	inline const char* precision_name(Precision precision)
+	{
+		return precision == Precision::FP16 ? "fp16" : precision == Precision::BF16 ? "bf16" : "fp32";
+	}
+
+	inline uint16_t float_to_bf16(float x)
+	{
+		uint32_t b;
+		memcpy(&b, &x, sizeof(b));
+		if ((b & 0x7fffffff) > 0x7f800000)
+			return 0x7fc0;
+		return (uint16_t)((b + 0x7fff + ((b >> 16) & 1)) >> 16);
+	}
+
+	inline float bf16_to_float(uint16_t h)
+	{
+		uint32_t b = (uint32_t)h << 16;
+		float x;
+		memcpy(&x, &b, sizeof(x));
+		return x;
+	}
+
+	// round to nearest even, overflow goes to infinity and small values to subnormals
+	inline uint16_t float_to_fp16(float x)
+	{
+		uint32_t b;
+		memcpy(&b, &x, sizeof(b));
+		uint32_t sign = (b >> 16) & 0x8000;
+		uint32_t abs = b & 0x7fffffff;
+		if (abs > 0x7f800000)
+			return (uint16_t)(sign | 0x7e00);
+		if (abs >= 0x477ff000)
+			return (uint16_t)(sign | 0x7c00);
+		if (abs < 0x38800000)
+		{
+			// subnormal: shift the implicit bit in, then round what falls off
+			if (abs < 0x33000000)
+				return (uint16_t)sign;
+			int shift = 126 - (int)(abs >> 23);
+			uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t midpoint = 1u << (shift - 1);
+			if (rest > midpoint || (rest == midpoint && (half & 1)))
+				half++;
+			return (uint16_t)(sign | half);
+		}
+		uint32_t half = (abs - 0x38000000) >> 13;
+		uint32_t rest = abs & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	inline float fp16_to_float(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		uint32_t b;
+		if (exponent == 0x1f)
+			b = sign | 0x7f800000 | (mantissa << 13);
+		else if (exponent != 0)
+			b = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		else if (mantissa == 0)
+			b = sign;
+		else
+		{
+			exponent = 113;
+			while (!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			b = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		float x;
+		memcpy(&x, &b, sizeof(x));
+		return x;
+	}
+
+	// fp16 goes through F16C eight values at a time on AVX2 builds
+	inline void to_half(const float* src, uint16_t* dst, int n, Precision precision)
+	{
+		int i = 0;
+		if (precision == Precision::BF16)
+		{
+			for (; i < n; i++)
+				dst[i] = float_to_bf16(src[i]);
+			return;
+		}
+#ifdef __AVX2__
+		for (; i + 8 <= n; i += 8)
+			_mm_storeu_si128((__m128i*)&dst[i], _mm256_cvtps_ph(_mm256_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT));
+#endif
+		for (; i < n; i++)
+			dst[i] = float_to_fp16(src[i]);
+	}
+
+	inline void from_half(const uint16_t* src, float* dst, int n, Precision precision)
+	{
+		int i = 0;
+		if (precision == Precision::BF16)
+		{
+			for (; i < n; i++)
+				dst[i] = bf16_to_float(src[i]);
+			return;
+		}
+#ifdef __AVX2__
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&src[i])));
+#endif
+		for (; i < n; i++)
+			dst[i] = fp16_to_float(src[i]);
+	}
+}
@@ -0,0 +1,94 @@
+#include "Model.h"
+#include <assert.h>
+#include <algorithm>
+
+namespace StrikingDummy
+{
+	// sigmoid(x) = 0.5 + 0.5 * tanh(x / 2). Eigen vectorizes tanh with a clamped rational
+	// approximation, which stays within 1e-6 of the exact logistic function everywhere.
+	template<typename T>
+	inline void sigmoid(T& x)
+	{
+		x = (0.5f * x).array().tanh() * 0.5f + 0.5f;
+	}
+
+	void Inference::set_features(const std::vector<int>& dense, const std::vector<int>& flags)
+	{
+		assert(dense.size() + flags.size() <= MAX_INPUTS);
+
+		num_dense = (int)dense.size();
+		num_flags = (int)flags.size();
+		std::copy(dense.begin(), dense.end(), this->dense);
+		std::copy(flags.begin(), flags.end(), this->flags);
+	}
+
+	void Inference::set_weights(const MatrixXf& W1, const MatrixXf& W2, const MatrixXf& W3, const MatrixXf& b1, const MatrixXf& b2, const MatrixXf& b3)
+	{
+		assert(W1.cols() <= MAX_INPUTS);
+		assert(W3.rows() <= MAX_OUTPUTS);
+
+		input_size = W1.cols();
+		output_size = W3.rows();
+
+		assert(num_dense + num_flags == input_size);
+
+		this->W1 = W1;
+		W1d.resize(INNER_1, num_dense);
+		for (int k = 0; k < num_dense; k++)
+			W1d.col(k) = W1.col(dense[k]);
+		this->W2 = W2;
+		this->W3t = W3.transpose();
+		this->b1 = b1;
+		this->b2 = b2;
+		this->b3 = b3;
+		version++;
+	}
+
+	void Inference::hidden(const float* state, Matrix<float, INNER_2, 1>& x2) const
+	{
+		Matrix<float, Dynamic, 1, ColMajor, MAX_INPUTS, 1> x0(num_dense);
+		Matrix<float, INNER_1, 1> x1;
+
+		gather_dense(state, x0);
+		x1.noalias() = W1d * x0;
+		x1 += b1;
+		add_flags(state, x1);
+		sigmoid(x1);
+
+		x2.noalias() = W2 * x1;
+		x2 += b2;
+		sigmoid(x2);
+	}
+
+	void Inference::compute(const float* state, float* output) const
+	{
+		Matrix<float, INNER_2, 1> x2;
+		hidden(state, x2);
+
+		Map<VectorXf> x3(output, output_size);
+		x3.noalias() = W3t.transpose() * x2;
+		x3 += b3;
+	}
+
+	int Inference::select(const float* state, const std::vector<int>& actions) const
+	{
+		Matrix<float, INNER_2, 1> x2;
+		hidden(state, x2);
+
+		// the output sigmoid is monotonic, so the argmax can be taken on the raw outputs
+		int max_action = actions[0];
+		float max_weight = W3t.col(max_action).dot(x2) + b3(max_action);
+		auto cend = actions.cend();
+		for (auto iter = actions.cbegin() + 1; iter != cend; iter++)
+		{
+			int index = *iter;
+			float weight = W3t.col(index).dot(x2) + b3(index);
+			if (weight > max_weight)
+			{
+				max_weight = weight;
+				max_action = index;
+			}
+		}
+		return max_action;
+	}
+}
@@ -0,0 +1,161 @@
+#include "InferenceQueue.h"
+#include <chrono>
+
+namespace StrikingDummy
+{
+	InferenceQueue::InferenceQueue(const Inference& inference, int max_batch, int max_latency) :
+		max_batch(max_batch), max_latency(max_latency), inference(inference)
+	{
+		X0 = MatrixXf(inference.num_dense, max_batch);
+		X1 = MatrixXf(INNER_1, max_batch);
+		X2 = MatrixXf(INNER_2, max_batch);
+		X3 = MatrixXf(inference.output_size, max_batch);
+		statistics.batch_sizes.resize(max_batch + 1);
+
+		batcher = std::thread(&InferenceQueue::run, this);
+	}
+
+	InferenceQueue::~InferenceQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		pending.notify_all();
+		batcher.join();
+	}
+
+	void InferenceQueue::set_producers(int producers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->producers = producers;
+		}
+		pending.notify_one();
+	}
+
+	void InferenceQueue::update(const Inference& inference)
+	{
+		std::lock_guard<std::mutex> lock(weights);
+		this->inference = inference;
+		X0.resize(inference.num_dense, max_batch);
+		X3.resize(inference.output_size, max_batch);
+	}
+
+	void InferenceQueue::compute(const float* state, float* output)
+	{
+		Request request = { state, output, false, std::chrono::steady_clock::now() };
+
+		std::unique_lock<std::mutex> lock(mutex);
+		queue.push_back(&request);
+		int full = producers > 0 ? std::min(producers, max_batch) : max_batch;
+		if (queue.size() == 1 || (int)queue.size() >= full)
+			pending.notify_one();
+		finished.wait(lock, [&] { return request.done; });
+	}
+
+	int InferenceQueue::select(const float* state, const std::vector<int>& actions)
+	{
+		float output[Inference::MAX_OUTPUTS];
+		compute(state, output);
+
+		int max_action = actions[0];
+		float max_weight = output[max_action];
+		auto cend = actions.cend();
+		for (auto iter = actions.cbegin() + 1; iter != cend; iter++)
+		{
+			int index = *iter;
+			if (output[index] > max_weight)
+			{
+				max_weight = output[index];
+				max_action = index;
+			}
+		}
+		return max_action;
+	}
+
+	InferenceQueue::Statistics InferenceQueue::get_statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+
+	void InferenceQueue::reset_statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics = {};
+		statistics.batch_sizes.resize(max_batch + 1);
+	}
+
+	void InferenceQueue::run()
+	{
+		std::vector<Request*> batch;
+		batch.reserve(max_batch);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			pending.wait(lock, [&] { return !running || !queue.empty(); });
+			if (!running && queue.empty())
+				return;
+
+			// give other threads until the oldest request has waited max_latency to fill up the batch,
+			// which may already have passed when it queued up behind the previous batch
+			auto deadline = queue.front()->submitted + std::chrono::microseconds(max_latency);
+			pending.wait_until(lock, deadline, [&] { return !running || (int)queue.size() >= (producers > 0 ? std::min(producers, max_batch) : max_batch); });
+
+			int depth = queue.size();
+			int n = std::min(depth, max_batch);
+			batch.assign(queue.begin(), queue.begin() + n);
+			queue.erase(queue.begin(), queue.begin() + n);
+
+			statistics.requests += n;
+			statistics.batches++;
+			statistics.total_batch_size += n;
+			statistics.total_queue_depth += depth;
+			statistics.max_batch_size = std::max(statistics.max_batch_size, n);
+			statistics.max_queue_depth = std::max(statistics.max_queue_depth, depth);
+			statistics.batch_sizes[n]++;
+
+			lock.unlock();
+
+			{
+				std::lock_guard<std::mutex> in_flight(weights);
+
+				for (int i = 0; i < n; i++)
+					inference.gather_dense(batch[i]->state, X0.col(i));
+
+				forward(batch);
+
+				for (int i = 0; i < n; i++)
+					Map<VectorXf>(batch[i]->output, inference.output_size) = X3.col(i);
+			}
+
+			lock.lock();
+			for (Request* request : batch)
+				request->done = true;
+			finished.notify_all();
+		}
+	}
+
+	void InferenceQueue::forward(const std::vector<Request*>& batch)
+	{
+		int n = (int)batch.size();
+		auto X1 = this->X1.leftCols(n);
+		auto X2 = this->X2.leftCols(n);
+		auto X3 = this->X3.leftCols(n);
+
+		X1.noalias() = inference.W1d * X0.leftCols(n);
+		X1.colwise() += inference.b1;
+		for (int i = 0; i < n; i++)
+			inference.add_flags(batch[i]->state, X1.col(i));
+		X1 = (0.5f * X1.array()).tanh() * 0.5f + 0.5f;
+
+		X2.noalias() = inference.W2 * X1;
+		X2.colwise() += inference.b2;
+		X2 = (0.5f * X2.array()).tanh() * 0.5f + 0.5f;
+
+		X3.noalias() = inference.W3t.transpose() * X2;
+		X3.colwise() += inference.b3;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Model.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Collects single-state requests from many simulation threads and answers them with one
+	// batched forward pass. A batch is run as soon as max_batch requests are waiting or the
+	// oldest request has waited max_latency microseconds, whichever comes first. Callers that know
+	// how many threads can have a request outstanding at once set producers, and a batch of that
+	// many does not wait either. Batches run on the queue's own copy of the weights, so the model it
+	// was made from can keep training; update swaps in new weights between batches.
+	struct InferenceQueue
+	{
+		struct Request
+		{
+			const float* state;
+			float* output;
+			bool done;
+			std::chrono::steady_clock::time_point submitted;
+		};
+
+		struct Statistics
+		{
+			long long requests = 0;
+			long long batches = 0;
+			long long total_batch_size = 0;
+			long long total_queue_depth = 0;
+			int max_batch_size = 0;
+			int max_queue_depth = 0;
+			std::vector<long long> batch_sizes;	// histogram, indexed by batch size
+
+			float mean_batch_size() const { return batches ? (float)total_batch_size / batches : 0.0f; }
+			float mean_queue_depth() const { return batches ? (float)total_queue_depth / batches : 0.0f; }
+		};
+
+		const int max_batch;
+		const int max_latency;
+
+		InferenceQueue(const Inference& inference, int max_batch, int max_latency = 20);
+		~InferenceQueue();
+
+		void set_producers(int producers);
+
+		// waits for the batch in flight, if any, requests still queued are answered with the new weights
+		void update(const Inference& inference);
+
+		void compute(const float* state, float* output);
+		int select(const float* state, const std::vector<int>& actions);
+
+		Statistics get_statistics();
+		void reset_statistics();
+
+	private:
+		std::mutex mutex;
+		std::condition_variable pending;
+		std::condition_variable finished;
+		std::deque<Request*> queue;
+		Statistics statistics;
+		bool running = true;
+		int producers = 0;
+
+		std::mutex weights;		// held by the batcher while it runs a batch
+		Inference inference;
+
+		MatrixXf X0;
+		MatrixXf X1;
+		MatrixXf X2;
+		MatrixXf X3;
+
+		std::thread batcher;
+
+		void run();
+		void forward(const std::vector<Request*>& batch);
+	};
+}
@@ -28,22 +28,6 @@ namespace StrikingDummy
 		tick = std::uniform_int_distribution<int>(1, 3000);
 	}
 
-	void Job::step()
-	{
-		int elapsed;
-		while (!timeline.events.empty())
-		{
-			if ((elapsed = timeline.next_event()) > 0)
-			{
-				update(elapsed);
-				// need at least 1 useable action that is not NONE (0)
-				if (actions.empty() || (actions.size() == 1 && actions[0] == 0))
-					continue;
-				break;
-			}
-		}
-	}
-
 	void Job::push_event(int offset)
 	{
 		if (offset > 0)
@@ -90,6 +74,19 @@ namespace StrikingDummy
 		events.push(time + offset);
 	}
 
+	const std::vector<int>& Timeline::pending() const
+	{
+		// the container is a protected member of priority_queue, reached through a derived class
+		struct Access : std::priority_queue<int, std::vector<int>, std::greater<int>>
+		{
+			static const std::vector<int>& of(const std::priority_queue<int, std::vector<int>, std::greater<int>>& queue)
+			{
+				return queue.*(&Access::c);
+			}
+		};
+		return Access::of(events);
+	}
+
 	// ============================================ Timer ============================================
 
 	void Timer::update(int elapsed)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Memory.h"
 #include <queue>
 #include <random>
 
@@ -41,6 +42,9 @@ namespace StrikingDummy
 
 		int next_event();
 		void push_event(int offset);
+
+		// the pending events in heap order, without copying the queue
+		const std::vector<int>& pending() const;
 	};
 
 	struct Timer
@@ -68,7 +72,7 @@ namespace StrikingDummy
 		int action = 0;
 		float reward = 0.0f;
 		int dt = 0;
-		std::vector<int> actions;
+		unsigned int actions = 0;	// bit i set <=> action i is usable at t1
 	};
 
 	struct Job
@@ -76,7 +80,7 @@ namespace StrikingDummy
 		Stats stats;
 		Timeline timeline;
 		std::vector<int> actions;
-		std::vector<Transition> history;
+		std::vector<Transition, TrackedAllocator<Transition, MemoryTag::HISTORY>> history;
 
 		std::mt19937 rng;
 		std::uniform_real_distribution<float> prob;
@@ -86,13 +90,33 @@ namespace StrikingDummy
 		float total_damage = 0.0f;
 
 		Job(Stats& job_stats, float job_attr);
-		void step();
+		void step() { advance<Job>(); }
 		float* get_state() { return history.back().t0; }
 
+		// the event loop behind step. Instantiated with a final job type, update is called directly
+		template <typename T>
+		void advance()
+		{
+			T& job = static_cast<T&>(*this);
+			int elapsed;
+			while (!timeline.events.empty())
+			{
+				if ((elapsed = timeline.next_event()) > 0)
+				{
+					job.update(elapsed);
+					// need at least 1 useable action that is not NONE (0)
+					if (actions.empty() || (actions.size() == 1 && actions[0] == 0))
+						continue;
+					break;
+				}
+			}
+		}
+
 		virtual void reset() = 0;
 		virtual void use_action(int action) = 0;
 		virtual void get_state(float* state) = 0;
 		virtual int get_state_size() = 0;
+		virtual std::vector<int> get_state_flags() = 0;	// state indices of the features that are only ever 0 or 1
 		virtual int get_num_actions() = 0;
 		virtual std::string get_action_name(int action) = 0;
 		virtual std::string get_info() = 0;
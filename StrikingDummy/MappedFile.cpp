@@ -0,0 +1,126 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace StrikingDummy
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const char* filename, bool writable, size_t size)
+	{
+		close();
+
+		this->writable = writable;
+		existing_size = 0;
+
+#ifdef _WIN32
+		HANDLE handle = writable ?
+			CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL) :
+			CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+			return false;
+		file = (intptr_t)handle;
+
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(handle, &file_size))
+			existing_size = (size_t)file_size.QuadPart;
+		if (!writable)
+			size = existing_size;
+		else if (existing_size != size)
+		{
+			LARGE_INTEGER target;
+			target.QuadPart = (LONGLONG)size;
+			if (!SetFilePointerEx(handle, target, NULL, FILE_BEGIN) || !SetEndOfFile(handle))
+			{
+				close();
+				return false;
+			}
+		}
+		if (size == 0)
+		{
+			close();
+			return false;
+		}
+
+		mapping = CreateFileMappingA(handle, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+		if (mapping)
+			data = MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+#else
+		int fd = writable ? ::open(filename, O_RDWR | O_CREAT, 0644) : ::open(filename, O_RDONLY);
+		if (fd < 0)
+			return false;
+		file = fd;
+
+		struct stat st;
+		if (fstat(fd, &st) == 0)
+			existing_size = (size_t)st.st_size;
+		if (!writable)
+			size = existing_size;
+		else if (existing_size != size && ftruncate(fd, (off_t)size) != 0)
+		{
+			close();
+			return false;
+		}
+		if (size == 0)
+		{
+			close();
+			return false;
+		}
+
+		data = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+#endif
+		if (!data)
+		{
+			close();
+			return false;
+		}
+		this->size = size;
+		return true;
+	}
+
+	void MappedFile::flush()
+	{
+		if (!data || !writable)
+			return;
+#ifdef _WIN32
+		FlushViewOfFile(data, 0);
+#else
+		msync(data, size, MS_SYNC);
+#endif
+	}
+
+	void MappedFile::close()
+	{
+		flush();
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != -1)
+			CloseHandle((HANDLE)file);
+#else
+		if (data)
+			munmap(data, size);
+		if (file != -1)
+			::close((int)file);
+#endif
+		data = NULL;
+		size = 0;
+		mapping = NULL;
+		file = -1;
+	}
+}
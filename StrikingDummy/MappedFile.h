@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace StrikingDummy
+{
+	// A file mapped into the address space, either read-only or read-write.
+	struct MappedFile
+	{
+		void* data = NULL;
+		size_t size = 0;
+
+		~MappedFile();
+
+		// opening for writing creates the file and resizes it to size bytes
+		bool open(const char* filename, bool writable, size_t size = 0);
+		void flush();
+		void close();
+
+		bool is_open() const { return data != NULL; }
+
+		// size of the file before it was resized, 0 if it did not exist
+		size_t existing_size = 0;
+
+	private:
+		bool writable = false;
+		intptr_t file = -1;		// HANDLE on Windows, file descriptor elsewhere
+		void* mapping = NULL;
+	};
+}
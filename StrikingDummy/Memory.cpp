@@ -0,0 +1,109 @@
+#include "Memory.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace StrikingDummy
+{
+	namespace
+	{
+		const char* MEMORY_TAG_NAMES[] = { "replay", "replay mapped (virtual)", "history", "model host", "model device" };
+		static_assert(sizeof(MEMORY_TAG_NAMES) / sizeof(MEMORY_TAG_NAMES[0]) == (size_t)MemoryTag::COUNT, "one name per tag");
+
+		struct Counters
+		{
+			std::atomic<long long> current{ 0 };
+			std::atomic<long long> peak{ 0 };
+			std::atomic<long long> allocations{ 0 };
+			std::atomic<long long> frees{ 0 };
+		};
+
+		Counters counters[(int)MemoryTag::COUNT];
+
+		// keeps the blocks from allocate as aligned as malloc's
+		const size_t MEMORY_HEADER = 16;
+
+		std::string format_bytes(long long bytes)
+		{
+			std::stringstream ss;
+			ss.precision(3);
+			if (bytes >= 1ll << 30)
+				ss << bytes / (double)(1ll << 30) << " GB";
+			else if (bytes >= 1ll << 20)
+				ss << bytes / (double)(1ll << 20) << " MB";
+			else
+				ss << bytes / (double)(1ll << 10) << " KB";
+			return ss.str();
+		}
+	}
+
+	namespace Memory
+	{
+		void allocated(MemoryTag tag, size_t bytes)
+		{
+			Counters& c = counters[(int)tag];
+			long long current = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			long long peak = c.peak.load(std::memory_order_relaxed);
+			while (current > peak && !c.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+			c.allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void freed(MemoryTag tag, size_t bytes)
+		{
+			Counters& c = counters[(int)tag];
+			c.current.fetch_sub(bytes, std::memory_order_relaxed);
+			c.frees.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void* allocate(MemoryTag tag, size_t bytes)
+		{
+			char* p = (char*)malloc(MEMORY_HEADER + bytes);
+			if (!p)
+			{
+				std::cerr << "allocation of " << bytes << " bytes failed" << std::endl;
+				throw 0;
+			}
+			*(size_t*)p = bytes;
+			allocated(tag, bytes);
+			return p + MEMORY_HEADER;
+		}
+
+		void release(MemoryTag tag, void* p)
+		{
+			if (!p)
+				return;
+			char* block = (char*)p - MEMORY_HEADER;
+			freed(tag, *(size_t*)block);
+			free(block);
+		}
+
+		std::vector<MemoryUsage> snapshot()
+		{
+			std::vector<MemoryUsage> usage((int)MemoryTag::COUNT);
+			for (int tag = 0; tag < (int)MemoryTag::COUNT; tag++)
+			{
+				const Counters& c = counters[tag];
+				usage[tag].name = MEMORY_TAG_NAMES[tag];
+				usage[tag].current = c.current.load(std::memory_order_relaxed);
+				usage[tag].peak = c.peak.load(std::memory_order_relaxed);
+				usage[tag].allocations = c.allocations.load(std::memory_order_relaxed);
+				usage[tag].frees = c.frees.load(std::memory_order_relaxed);
+			}
+			return usage;
+		}
+
+		std::string report()
+		{
+			std::stringstream ss;
+			ss << "memory:";
+			bool first = true;
+			for (const MemoryUsage& usage : snapshot())
+			{
+				ss << (first ? " " : ", ") << usage.name << " " << format_bytes(usage.current) << " (peak " << format_bytes(usage.peak) << ", " << usage.allocations - usage.frees << " live)";
+				first = false;
+			}
+			return ss.str();
+		}
+	}
+}
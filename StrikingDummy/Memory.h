@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Subsystems whose memory is accounted for
+	enum class MemoryTag
+	{
+		REPLAY,			// anonymous replay memory, as allocated (rounded up to large pages)
+		REPLAY_MAPPED,	// file mapped replay memory: mapped size, not what is resident
+		HISTORY,		// Job::history of every job
+		MODEL_HOST,		// host side minibatch buffers of models
+		MODEL_DEVICE,	// device buffers from matrixInitialize and friends
+		COUNT
+	};
+
+	struct MemoryUsage
+	{
+		const char* name;
+		long long current = 0;		// bytes
+		long long peak = 0;
+		long long allocations = 0;
+		long long frees = 0;
+	};
+
+	// Per tag byte counts, kept with relaxed atomics so the hooks cost a few uncontended adds. Allocations
+	// made elsewhere (mapped files, device memory) are reported with allocated/freed, host buffers go through
+	// allocate/release and containers through TrackedAllocator.
+	namespace Memory
+	{
+		void allocated(MemoryTag tag, size_t bytes);
+		void freed(MemoryTag tag, size_t bytes);
+
+		// malloc with the size kept in front of the block, so release needs no size
+		void* allocate(MemoryTag tag, size_t bytes);
+		void release(MemoryTag tag, void* p);
+
+		std::vector<MemoryUsage> snapshot();
+		std::string report();	// one line, current and peak per tag
+	}
+
+	template <typename T, MemoryTag tag>
+	struct TrackedAllocator
+	{
+		typedef T value_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef TrackedAllocator<U, tag> other;
+		};
+
+		TrackedAllocator() = default;
+		template <typename U>
+		TrackedAllocator(const TrackedAllocator<U, tag>&) {}
+
+		T* allocate(size_t n)
+		{
+			T* p = std::allocator<T>().allocate(n);
+			Memory::allocated(tag, sizeof(T) * n);
+			return p;
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+			Memory::freed(tag, sizeof(T) * n);
+			std::allocator<T>().deallocate(p, n);
+		}
+
+		template <typename U>
+		bool operator==(const TrackedAllocator<U, tag>&) const { return true; }
+		template <typename U>
+		bool operator!=(const TrackedAllocator<U, tag>&) const { return false; }
+	};
+}
@@ -0,0 +1,96 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+
+namespace StrikingDummy
+{
+	void Metrics::init(const std::vector<std::string>& action_names, const std::vector<std::string>& buff_names)
+	{
+		this->action_names = action_names;
+		this->buff_names = buff_names;
+		size_t num_actions = action_names.size();
+		fights = 0;
+		time = 0;
+		casts.assign(num_actions, 0);
+		damage.assign(num_actions, 0.0);
+		tick_damage.assign(num_actions, 0.0);
+		drift.assign(num_actions, std::vector<int>());
+		buff_time.assign(buff_names.size(), 0);
+		ready.assign(num_actions, 0);
+	}
+
+	void Metrics::reset()
+	{
+		fights = 1;
+		time = 0;
+		std::fill(casts.begin(), casts.end(), 0);
+		std::fill(damage.begin(), damage.end(), 0.0);
+		std::fill(tick_damage.begin(), tick_damage.end(), 0.0);
+		for (std::vector<int>& samples : drift)
+			samples.clear();
+		std::fill(buff_time.begin(), buff_time.end(), 0);
+		std::fill(ready.begin(), ready.end(), 0);
+	}
+
+	double Metrics::total_damage() const
+	{
+		return std::accumulate(damage.begin(), damage.end(), 0.0) + std::accumulate(tick_damage.begin(), tick_damage.end(), 0.0);
+	}
+
+	void Metrics::merge(const Metrics& other)
+	{
+		if (action_names.empty())
+			init(other.action_names, other.buff_names);
+		fights += other.fights;
+		time += other.time;
+		for (size_t action = 0; action < casts.size(); action++)
+		{
+			casts[action] += other.casts[action];
+			damage[action] += other.damage[action];
+			tick_damage[action] += other.tick_damage[action];
+			drift[action].insert(drift[action].end(), other.drift[action].begin(), other.drift[action].end());
+		}
+		for (size_t buff = 0; buff < buff_time.size(); buff++)
+			buff_time[buff] += other.buff_time[buff];
+	}
+
+	std::string Metrics::json() const
+	{
+		std::stringstream ss;
+		ss.precision(10);
+		ss << "{\n\t\"fights\": " << fights << ",\n\t\"time\": " << time << ",\n\t\"actions\": [";
+		for (size_t action = 0; action < casts.size(); action++)
+		{
+			ss << (action ? "," : "") << "\n\t\t{ \"name\": \"" << action_names[action] << "\", \"casts\": " << casts[action];
+			ss << ", \"damage\": " << damage[action] << ", \"tick_damage\": " << tick_damage[action] << ", \"drift\": [";
+			for (size_t i = 0; i < drift[action].size(); i++)
+				ss << (i ? ", " : "") << drift[action][i];
+			ss << "] }";
+		}
+		ss << "\n\t],\n\t\"buffs\": [";
+		for (size_t buff = 0; buff < buff_time.size(); buff++)
+			ss << (buff ? "," : "") << "\n\t\t{ \"name\": \"" << buff_names[buff] << "\", \"time\": " << buff_time[buff] << " }";
+		ss << "\n\t]\n}\n";
+		return ss.str();
+	}
+
+	// one row per action followed by one row per buff, drift samples trail the action rows
+	std::string Metrics::csv() const
+	{
+		std::stringstream ss;
+		ss.precision(10);
+		ss << "action,casts,damage,tick_damage,drift\n";
+		for (size_t action = 0; action < casts.size(); action++)
+		{
+			ss << action_names[action] << "," << casts[action] << "," << damage[action] << "," << tick_damage[action];
+			for (int t : drift[action])
+				ss << "," << t;
+			ss << "\n";
+		}
+		ss << "buff,time\n";
+		for (size_t buff = 0; buff < buff_time.size(); buff++)
+			ss << buff_names[buff] << "," << buff_time[buff] << "\n";
+		return ss.str();
+	}
+}
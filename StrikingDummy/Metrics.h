@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Fight time, damage per action and dot uptime are recorded in every build, trace reports them. Casts,
+// cooldown drift and the other buff uptimes are recorded only when built with SD_METRICS defined (the
+// Metrics configuration), otherwise METRIC(x) expands to nothing and training builds skip them.
+#ifdef SD_METRICS
+#define METRIC(x) x
+#else
+#define METRIC(x)
+#endif
+
+namespace StrikingDummy
+{
+	// Per action and per buff totals. A job's metrics cover its current fight; copies taken at the end of
+	// fights, on any thread, are combined with merge.
+	struct Metrics
+	{
+#ifdef SD_METRICS
+		static constexpr bool enabled = true;
+#else
+		static constexpr bool enabled = false;
+#endif
+
+		std::vector<std::string> action_names;
+		std::vector<std::string> buff_names;
+
+		long long fights = 0;
+		long long time = 0;							// ms
+		std::vector<long long> casts;				// per action
+		std::vector<double> damage;					// per action, damage of the hit itself
+		std::vector<double> tick_damage;			// per action, damage over time it applied
+		std::vector<std::vector<int>> drift;		// per action, ms from coming off cooldown to being used again
+		std::vector<long long> buff_time;			// per buff, ms it was up
+
+		void init(const std::vector<std::string>& action_names, const std::vector<std::string>& buff_names);
+		void reset();	// starts a new fight
+
+		void cast(int action) { casts[action]++; }
+		void hit(int action, float amount) { damage[action] += amount; }
+		void tick(int action, float amount) { tick_damage[action] += amount; }
+		void use(int action, int now, int cooldown)
+		{
+			drift[action].push_back(now - ready[action]);
+			ready[action] = now + cooldown;
+		}
+		void ready_at(int action, int time) { ready[action] = time; }
+
+		double total_damage() const;
+		void merge(const Metrics& other);
+
+		std::string json() const;
+		std::string csv() const;
+
+	private:
+		std::vector<int> ready;		// per action, when the current fight next has it off cooldown
+	};
+}
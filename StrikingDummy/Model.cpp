@@ -1,41 +1,81 @@
 #include "Model.h"
 #include "CUDA.cuh"
-#include <fstream>
+#include "Memory.h"
+#include <algorithm>
 #include <iostream>
 
 namespace StrikingDummy
 {
-	const int INNER_1 = 128;
-	const int INNER_2 = 128;
+	template <typename T>
+	static T* host_new(size_t n)
+	{
+		return (T*)Memory::allocate(MemoryTag::MODEL_HOST, sizeof(T) * n);
+	}
 
-	float sigmoid(float x)
+	template <typename T>
+	static void host_delete(T*& p)
 	{
-		return 1.0f / (1.0f + expf(-x));
+		Memory::release(MemoryTag::MODEL_HOST, p);
+		p = NULL;
 	}
 
-	void Model::init(int input_size, int output_size, int batch_size, bool adam)
+	void Model::init(int input_size, int output_size, int batch_size, bool adam, const std::vector<int>& flags, Precision precision)
 	{
 		cudaInitialize();
 
+		// a model that is initialized again starts over
+		release();
+
 		this->input_size = input_size;
 		this->output_size = output_size;
 		this->batch_size = batch_size;
 		this->adam = adam;
-
-		x0 = new float[input_size];
-		x3 = new float[output_size];
-		X0 = new float[input_size * batch_size];
-		X3 = new float[output_size * batch_size];
-		target = new float[output_size * batch_size];
+		this->precision = precision;
+
+		this->flags = flags;
+		dense.clear();
+		for (int i = 0; i < input_size; i++)
+			if (std::find(flags.begin(), flags.end(), i) == flags.end())
+				dense.push_back(i);
+		int num_dense = (int)dense.size();
+		int num_flags = (int)flags.size();
+
+		x0 = host_new<float>(input_size);
+		x3 = host_new<float>(output_size);
+		X0 = host_new<float>(input_size * batch_size * 2);
+		X0_next = host_new<float>(input_size * batch_size * 2);
+		X3 = host_new<float>(output_size * batch_size * 2);
+		target = host_new<float>(output_size * batch_size);
+		for (Split* s : { &split, &split_next })
+		{
+			if (precision == Precision::FP32)
+				s->X0d = host_new<float>(num_dense * batch_size * 2);
+			else
+				s->X0h = host_new<unsigned short>(num_dense * batch_size * 2);
+			s->active_offsets.resize(batch_size * 2 + 1);
+			s->active.resize(num_flags * batch_size * 2);
+			s->sample_offsets.resize(num_flags + 1);
+			s->samples.resize(num_flags * batch_size);
+		}
 
 		matrixInitialize(&_x0, input_size, 1);
 		matrixInitialize(&_x1, INNER_1, 1);
 		matrixInitialize(&_x2, INNER_2, 1);
 		matrixInitialize(&_x3, output_size, 1);
-		matrixInitialize(&_X0, input_size, batch_size);
-		matrixInitialize(&_X1, INNER_1, batch_size);
-		matrixInitialize(&_X2, INNER_2, batch_size);
-		matrixInitialize(&_X3, output_size, batch_size);
+		if (precision == Precision::FP32)
+			matrixInitialize(&_X0, num_dense, batch_size * 2);
+		else
+		{
+			halfInitialize(&_X0h, num_dense, batch_size * 2);
+			halfInitialize(&_X1h, INNER_1, batch_size * 2);
+			halfInitialize(&_X2h, INNER_2, batch_size * 2);
+			halfInitialize(&_W1h, INNER_1, num_dense);
+			halfInitialize(&_W2h, INNER_2, INNER_1);
+			halfInitialize(&_W3h, output_size, INNER_2);
+		}
+		matrixInitialize(&_X1, INNER_1, batch_size * 2);
+		matrixInitialize(&_X2, INNER_2, batch_size * 2);
+		matrixInitialize(&_X3, output_size, batch_size * 2);
 		matrixInitialize(&_target, output_size, batch_size);
 		matrixInitialize(&_W1, INNER_1, input_size, sqrtf(96.0f / (INNER_1 + input_size)));
 		matrixInitialize(&_W2, INNER_2, INNER_1, sqrtf(96.0f / (INNER_2 + INNER_1)));
@@ -47,11 +87,23 @@ namespace StrikingDummy
 		matrixInitialize(&_d2, INNER_2, batch_size);
 		matrixInitialize(&_d3, output_size, batch_size);
 		matrixInitialize(&_dLdW1, INNER_1, input_size);
+		matrixInitialize(&_W1d, INNER_1, num_dense);
+		matrixInitialize(&_dLdW1d, INNER_1, num_dense);
+		matrixInitialize(&_dLdW1f, INNER_1, num_flags);
+		indexInitialize(&_dense, num_dense);
+		indexInitialize(&_flags, num_flags);
+		indexInitialize(&_active_offsets, batch_size * 2 + 1);
+		indexInitialize(&_active, num_flags * batch_size * 2);
+		indexInitialize(&_sample_offsets, num_flags + 1);
+		indexInitialize(&_samples, num_flags * batch_size);
+		indexCopyToDevice(_dense, dense.data(), num_dense);
+		indexCopyToDevice(_flags, this->flags.data(), num_flags);
 		matrixInitialize(&_dLdW2, INNER_2, INNER_1);
 		matrixInitialize(&_dLdW3, output_size, INNER_2);
 		matrixInitialize(&_dLdb1, INNER_1, 1);
 		matrixInitialize(&_dLdb2, INNER_2, 1);
 		matrixInitialize(&_dLdb3, output_size, 1);
+		matrixInitialize(&_weights, batch_size, 1);
 		matrixInitialize(&_ones, batch_size, 1);
 		arrayAdd(_ones, _ones, 1.0f, batch_size);
 
@@ -76,8 +128,6 @@ namespace StrikingDummy
 		matrixInitialize(&__W3, INNER_2, output_size);
 
 		m_x0 = MatrixXf(input_size, 1);
-		m_x1 = MatrixXf(INNER_1, 1);
-		m_x2 = MatrixXf(INNER_2, 1);
 		m_x3 = MatrixXf(output_size, 1);
 		m_W1 = MatrixXf(INNER_1, input_size);
 		m_W2 = MatrixXf(INNER_2, INNER_1);
@@ -89,15 +139,29 @@ namespace StrikingDummy
 		arrayCopyToHost(m_W1.data(), _W1, INNER_1 * input_size);
 		arrayCopyToHost(m_W2.data(), _W2, INNER_2 * INNER_1);
 		arrayCopyToHost(m_W3.data(), _W3, output_size * INNER_2);
+
+		inference.set_features(dense, flags);
+		inference.set_weights(m_W1, m_W2, m_W3, m_b1, m_b2, m_b3);
 	}
 
 	Model::~Model()
 	{
-		delete[] x0;
-		delete[] x3;
-		delete[] X0;
-		delete[] X3;
-		delete[] target;
+		release();
+	}
+
+	void Model::release()
+	{
+		host_delete(x0);
+		host_delete(x3);
+		host_delete(X0);
+		host_delete(X0_next);
+		host_delete(X3);
+		host_delete(target);
+		for (Split* s : { &split, &split_next })
+		{
+			host_delete(s->X0d);
+			host_delete(s->X0h);
+		}
 
 		matrixFree(&_x0);
 		matrixFree(&_x1);
@@ -118,11 +182,21 @@ namespace StrikingDummy
 		matrixFree(&_d2);
 		matrixFree(&_d3);
 		matrixFree(&_dLdW1);
+		matrixFree(&_W1d);
+		matrixFree(&_dLdW1d);
+		matrixFree(&_dLdW1f);
+		indexFree(&_dense);
+		indexFree(&_flags);
+		indexFree(&_active_offsets);
+		indexFree(&_active);
+		indexFree(&_sample_offsets);
+		indexFree(&_samples);
 		matrixFree(&_dLdW2);
 		matrixFree(&_dLdW3);
 		matrixFree(&_dLdb1);
 		matrixFree(&_dLdb2);
 		matrixFree(&_dLdb3);
+		matrixFree(&_weights);
 		matrixFree(&_ones);
 
 		matrixFree(&_dLdW1m);
@@ -139,6 +213,13 @@ namespace StrikingDummy
 		matrixFree(&_dLdb3v);
 		matrixFree(&_temp);
 
+		halfFree(&_X0h);
+		halfFree(&_X1h);
+		halfFree(&_X2h);
+		halfFree(&_W1h);
+		halfFree(&_W2h);
+		halfFree(&_W3h);
+
 		matrixFree(&__X0);
 		matrixFree(&__X1);
 		matrixFree(&__X2);
@@ -148,25 +229,77 @@ namespace StrikingDummy
 
 	float* Model::compute()
 	{
-		m_x1 = (m_W1 * m_x0 + m_b1).unaryExpr(&sigmoid);
-		m_x2 = (m_W2 * m_x1 + m_b2).unaryExpr(&sigmoid);
-		m_x3 = (m_W3 * m_x2 + m_b3);
+		inference.compute(m_x0.data(), m_x3.data());
 		return m_x3.data();
 	}
 
 	float* Model::batch_compute()
 	{
-		arrayCopyToDevice(_X0, X0, input_size * batch_size);
-
-		matrixMultiply(_X1, _W1, INNER_1, input_size, _X0, input_size, batch_size);
-		arrayAddRep(_X1, _X1, _b1, INNER_1, batch_size);
-		arraySigmoid(_X1, _X1, INNER_1 * batch_size);
+		// t1 and t0 states go through the network together
+		int batch_size = 2 * this->batch_size;
+		bool reduced = precision != Precision::FP32;
+		bool bf16 = precision == Precision::BF16;
+
+		int num_dense = (int)dense.size();
+		if (reduced)
+			halfCopyToDevice(_X0h, split.X0h, num_dense * batch_size);
+		else
+			arrayCopyToDevice(_X0, split.X0d, num_dense * batch_size);
+		indexCopyToDevice(_active_offsets, split.active_offsets.data(), batch_size + 1);
+		indexCopyToDevice(_active, split.active.data(), split.active_offsets[batch_size]);
+		indexCopyToDevice(_sample_offsets, split.sample_offsets.data(), (int)flags.size() + 1);
+		indexCopyToDevice(_samples, split.samples.data(), split.sample_offsets[flags.size()]);
+
+		// W1 * X0 = W1d * X0d + the columns of W1 for the flags set in each column
+		matrixGatherCols(_W1d, _W1, INNER_1, _dense, num_dense);
+		if (!reduced)
+			matrixMultiply(_X1, _W1d, INNER_1, num_dense, _X0, num_dense, batch_size);
+		else if (half_weights)
+		{
+			arrayToHalf(_W1h, _W1d, INNER_1 * num_dense, bf16);
+			matrixMultiply(_X1, _W1h, INNER_1, num_dense, _X0h, num_dense, batch_size, bf16);
+		}
+		else
+			matrixMultiply(_X1, _W1d, INNER_1, num_dense, _X0h, num_dense, batch_size, bf16);
+		matrixSumCols(_X1, _W1, INNER_1, _active_offsets, _active, batch_size, true);
 
-		matrixMultiply(_X2, _W2, INNER_2, INNER_1, _X1, INNER_1, batch_size);
-		arrayAddRep(_X2, _X2, _b2, INNER_2, batch_size);
-		arraySigmoid(_X2, _X2, INNER_2 * batch_size);
+		// in reduced precision _X1 and _X2 only ever hold the sums: the bias is added on the way into the
+		// sigmoid, which stores the activations in 16 bits, and nothing fp32 is written back
+		if (!reduced)
+		{
+			arrayAddRep(_X1, _X1, _b1, INNER_1, batch_size);
+			arraySigmoid(_X1, _X1, INNER_1 * batch_size);
+			matrixMultiply(_X2, _W2, INNER_2, INNER_1, _X1, INNER_1, batch_size);
+		}
+		else if (half_weights)
+		{
+			arraySigmoid(_X1h, _X1, _b1, INNER_1, batch_size, bf16);
+			arrayToHalf(_W2h, _W2, INNER_2 * INNER_1, bf16);
+			matrixMultiply(_X2, _W2h, INNER_2, INNER_1, _X1h, INNER_1, batch_size, bf16);
+		}
+		else
+		{
+			arraySigmoid(_X1h, _X1, _b1, INNER_1, batch_size, bf16);
+			matrixMultiply(_X2, _W2, INNER_2, INNER_1, _X1h, INNER_1, batch_size, bf16);
+		}
 
-		matrixMultiply(_X3, _W3, output_size, INNER_2, _X2, INNER_2, batch_size);
+		if (!reduced)
+		{
+			arrayAddRep(_X2, _X2, _b2, INNER_2, batch_size);
+			arraySigmoid(_X2, _X2, INNER_2 * batch_size);
+			matrixMultiply(_X3, _W3, output_size, INNER_2, _X2, INNER_2, batch_size);
+		}
+		else if (half_weights)
+		{
+			arraySigmoid(_X2h, _X2, _b2, INNER_2, batch_size, bf16);
+			arrayToHalf(_W3h, _W3, output_size * INNER_2, bf16);
+			matrixMultiply(_X3, _W3h, output_size, INNER_2, _X2h, INNER_2, batch_size, bf16);
+		}
+		else
+		{
+			arraySigmoid(_X2h, _X2, _b2, INNER_2, batch_size, bf16);
+			matrixMultiply(_X3, _W3, output_size, INNER_2, _X2h, INNER_2, batch_size, bf16);
+		}
 		arrayAddRep(_X3, _X3, _b3, output_size, batch_size);
 		arraySigmoid(_X3, _X3, output_size * batch_size);
 
@@ -174,8 +307,77 @@ namespace StrikingDummy
 		return X3;
 	}
 
-	void Model::train(float nu)
+	void Model::split_batch(bool next)
 	{
+		const float* X0 = next ? X0_next : this->X0;
+		Split& split = next ? split_next : this->split;
+		float* X0d = split.X0d;
+		unsigned short* X0h = split.X0h;
+		std::vector<int>& active_offsets = split.active_offsets;
+		std::vector<int>& active = split.active;
+		std::vector<int>& sample_offsets = split.sample_offsets;
+		std::vector<int>& samples = split.samples;
+		int num_dense = (int)dense.size();
+		int num_flags = (int)flags.size();
+
+		int n = 0;
+		std::fill(sample_offsets.begin(), sample_offsets.end(), 0);
+		for (int j = 0; j < 2 * batch_size; j++)
+		{
+			const float* x = X0 + input_size * j;
+			if (precision == Precision::FP32)
+			{
+				for (int k = 0; k < num_dense; k++)
+					X0d[num_dense * j + k] = x[dense[k]];
+			}
+			else
+			{
+				float column[Inference::MAX_INPUTS];
+				for (int k = 0; k < num_dense; k++)
+					column[k] = x[dense[k]];
+				to_half(column, X0h + num_dense * j, num_dense, precision);
+			}
+			active_offsets[j] = n;
+			for (int k = 0; k < num_flags; k++)
+			{
+				if (x[flags[k]] != 0.0f)
+				{
+					active[n++] = flags[k];
+					if (j >= batch_size)
+						sample_offsets[k + 1]++;
+				}
+			}
+		}
+		active_offsets[2 * batch_size] = n;
+
+		// samples are only needed for the t0 half, which is the one train backpropagates through
+		for (int k = 0; k < num_flags; k++)
+			sample_offsets[k + 1] += sample_offsets[k];
+		std::vector<int> cursor(sample_offsets.begin(), sample_offsets.end() - 1);
+		for (int j = batch_size; j < 2 * batch_size; j++)
+		{
+			const float* x = X0 + input_size * j;
+			for (int k = 0; k < num_flags; k++)
+				if (x[flags[k]] != 0.0f)
+					samples[cursor[k]++] = j - batch_size;
+		}
+	}
+
+	void Model::train(float nu, float* weights)
+	{
+		// backpropagate through the t0 half of the last forward pass
+		int num_dense = (int)dense.size();
+		int num_flags = (int)flags.size();
+		float* _X0 = this->_X0 + num_dense * batch_size;
+		float* _X1 = this->_X1 + INNER_1 * batch_size;
+		float* _X2 = this->_X2 + INNER_2 * batch_size;
+		float* _X3 = this->_X3 + output_size * batch_size;
+		unsigned short* _X0h = this->_X0h + num_dense * batch_size;
+		unsigned short* _X1h = this->_X1h + INNER_1 * batch_size;
+		unsigned short* _X2h = this->_X2h + INNER_2 * batch_size;
+		bool reduced = precision != Precision::FP32;
+		bool bf16 = precision == Precision::BF16;
+
 		arrayCopyToDevice(_target, target, output_size * batch_size);
 
 		// d3 = (Xk - target).cwiseProduct(Xk.unaryExpr(&dsigmoid));
@@ -187,10 +389,20 @@ namespace StrikingDummy
 
 		arrayMultiply(_d3, _target, _X3, output_size * batch_size);
 
+		// importance-sampling weights, one per sample
+		if (weights)
+		{
+			arrayCopyToDevice(_weights, weights, batch_size);
+			arrayMultiplyCols(_d3, _d3, _weights, output_size, batch_size);
+		}
+
 		// 
 		//matrixTranspose(__X2, _X2, INNER_2, batch_size);
 		//matrixMultiply(_dLdW3, _d3, output_size, batch_size, __X2, batch_size, INNER_2);
-		matrixMultiplyTranspose(_dLdW3, _d3, output_size, batch_size, _X2, batch_size, INNER_2);
+		if (reduced)
+			matrixMultiplyTranspose(_dLdW3, _d3, output_size, batch_size, _X2h, batch_size, INNER_2, bf16);
+		else
+			matrixMultiplyTranspose(_dLdW3, _d3, output_size, batch_size, _X2, batch_size, INNER_2);
 
 		matrixMultiply(_dLdb3, _d3, output_size, batch_size, _ones, batch_size, 1);
 
@@ -199,14 +411,21 @@ namespace StrikingDummy
 
 		matrixMultiply(_d2, __W3, INNER_2, output_size, _d3, output_size, batch_size);
 
-		arrayDerivSigmoid(_X2, _X2, INNER_2 * batch_size);
-
-		arrayMultiply(_d2, _d2, _X2, INNER_2 * batch_size);
+		if (reduced)
+			arrayMultiplyDerivSigmoid(_d2, _d2, _X2h, INNER_2 * batch_size, bf16);
+		else
+		{
+			arrayDerivSigmoid(_X2, _X2, INNER_2 * batch_size);
+			arrayMultiply(_d2, _d2, _X2, INNER_2 * batch_size);
+		}
 
 		//
 		//matrixTranspose(__X1, _X1, INNER_1, batch_size);
 		//matrixMultiply(_dLdW2, _d2, INNER_2, batch_size, __X1, batch_size, INNER_1);
-		matrixMultiplyTranspose(_dLdW2, _d2, INNER_2, batch_size, _X1, batch_size, INNER_1);
+		if (reduced)
+			matrixMultiplyTranspose(_dLdW2, _d2, INNER_2, batch_size, _X1h, batch_size, INNER_1, bf16);
+		else
+			matrixMultiplyTranspose(_dLdW2, _d2, INNER_2, batch_size, _X1, batch_size, INNER_1);
 
 		matrixMultiply(_dLdb2, _d2, INNER_2, batch_size, _ones, batch_size, 1);
 
@@ -215,14 +434,27 @@ namespace StrikingDummy
 
 		matrixMultiply(_d1, __W2, INNER_1, INNER_2, _d2, INNER_2, batch_size);
 
-		arrayDerivSigmoid(_X1, _X1, INNER_1 * batch_size);
-
-		arrayMultiply(_d1, _d1, _X1, INNER_1 * batch_size);
+		if (reduced)
+			arrayMultiplyDerivSigmoid(_d1, _d1, _X1h, INNER_1 * batch_size, bf16);
+		else
+		{
+			arrayDerivSigmoid(_X1, _X1, INNER_1 * batch_size);
+			arrayMultiply(_d1, _d1, _X1, INNER_1 * batch_size);
+		}
 
 		//
 		//matrixTranspose(__X0, _X0, input_size, batch_size);
 		//matrixMultiply(_dLdW1, _d1, INNER_1, batch_size, __X0, batch_size, input_size);
-		matrixMultiplyTranspose(_dLdW1, _d1, INNER_1, batch_size, _X0, batch_size, input_size);
+		//matrixMultiplyTranspose(_dLdW1, _d1, INNER_1, batch_size, _X0, batch_size, input_size);
+		if (reduced)
+			matrixMultiplyTranspose(_dLdW1d, _d1, INNER_1, batch_size, _X0h, batch_size, num_dense, bf16);
+		else
+			matrixMultiplyTranspose(_dLdW1d, _d1, INNER_1, batch_size, _X0, batch_size, num_dense);
+		matrixScatterCols(_dLdW1, _dLdW1d, INNER_1, _dense, num_dense);
+
+		// the column of a flag is the sum of d1 over the samples that have it set
+		matrixSumCols(_dLdW1f, _d1, INNER_1, _sample_offsets, _samples, num_flags, false);
+		matrixScatterCols(_dLdW1, _dLdW1f, INNER_1, _flags, num_flags);
 
 		matrixMultiply(_dLdb1, _d1, INNER_1, batch_size, _ones, batch_size, 1);
 
@@ -365,42 +597,38 @@ namespace StrikingDummy
 		arrayCopyToHost(m_b1.data(), _b1, INNER_1);
 		arrayCopyToHost(m_b2.data(), _b2, INNER_2);
 		arrayCopyToHost(m_b3.data(), _b3, output_size);
+
+		inference.set_weights(m_W1, m_W2, m_W3, m_b1, m_b2, m_b3);
 	}
 
-	void Model::load(const char* filename)
+	void Model::copy(const Model& other)
 	{
-		std::fstream fs;
-		fs.open(filename, std::fstream::in | std::fstream::binary);
-		if (fs.is_open())
+		float* from[] = { other._W1, other._W2, other._W3, other._b1, other._b2, other._b3,
+			other._dLdW1m, other._dLdW2m, other._dLdW3m, other._dLdb1m, other._dLdb2m, other._dLdb3m,
+			other._dLdW1v, other._dLdW2v, other._dLdW3v, other._dLdb1v, other._dLdb2v, other._dLdb3v };
+		float* to[] = { _W1, _W2, _W3, _b1, _b2, _b3,
+			_dLdW1m, _dLdW2m, _dLdW3m, _dLdb1m, _dLdb2m, _dLdb3m,
+			_dLdW1v, _dLdW2v, _dLdW3v, _dLdb1v, _dLdb2v, _dLdb3v };
+		int sizes[] = { INNER_1 * input_size, INNER_2 * INNER_1, output_size * INNER_2, INNER_1, INNER_2, output_size };
+
+		std::vector<float> buffer;
+		for (int i = 0; i < 18; i++)
 		{
-			fs.read((char*)m_W1.data(), INNER_1 * input_size * sizeof(float));
-			fs.read((char*)m_W2.data(), INNER_2 * INNER_1 * sizeof(float));
-			fs.read((char*)m_W3.data(), output_size * INNER_2 * sizeof(float));
-			fs.read((char*)m_b1.data(), INNER_1 * sizeof(float));
-			fs.read((char*)m_b2.data(), INNER_2 * sizeof(float));
-			fs.read((char*)m_b3.data(), output_size * sizeof(float));
-			fs.close();
-
-			arrayCopyToDevice(_W1, m_W1.data(), INNER_1 * input_size);
-			arrayCopyToDevice(_W2, m_W2.data(), INNER_2 * INNER_1);
-			arrayCopyToDevice(_W3, m_W3.data(), output_size * INNER_2);
-			arrayCopyToDevice(_b1, m_b1.data(), INNER_1);
-			arrayCopyToDevice(_b2, m_b2.data(), INNER_2);
-			arrayCopyToDevice(_b3, m_b3.data(), output_size);
+			int n = sizes[i % 6];
+			buffer.resize(n);
+			arrayCopyToHost(buffer.data(), from[i], n);
+			arrayCopyToDevice(to[i], buffer.data(), n);
 		}
+		copyToHost();
+	}
+
+	bool Model::load(const char* filename, TrainerState* trainer)
+	{
+		return Checkpoint::load(filename, *this, trainer);
 	}
 
-	void Model::save(const char* filename)
+	void Model::save(const char* filename, const TrainerState* trainer)
 	{
-		std::fstream fs;
-		fs.open(filename, std::fstream::out | std::fstream::binary);
-		fs.write((const char*)m_W1.data(), INNER_1 * input_size * sizeof(float));
-		fs.write((const char*)m_W2.data(), INNER_2 * INNER_1 * sizeof(float));
-		fs.write((const char*)m_W3.data(), output_size * INNER_2 * sizeof(float));
-		fs.write((const char*)m_b1.data(), INNER_1 * sizeof(float));
-		fs.write((const char*)m_b2.data(), INNER_2 * sizeof(float));
-		fs.write((const char*)m_b3.data(), output_size * sizeof(float));
-		fs.flush();
-		fs.close();
+		Checkpoint::save(filename, *this, trainer);
 	}
 }
\ No newline at end of file
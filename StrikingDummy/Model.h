@@ -1,10 +1,15 @@
 #pragma once
+#include "Checkpoint.h"
+#include "Half.h"
 #include <Eigen/Core>
 #include <vector>
 using namespace Eigen;
 
 namespace StrikingDummy
 {
+	const int INNER_1 = 128;
+	const int INNER_2 = 128;
+
 	struct Layer
 	{
 		int num_units;
@@ -18,11 +23,70 @@ namespace StrikingDummy
 		int batch_size;
 	};
 
+	// Single-state forward pass on the host. Weights live in fixed-capacity aligned storage so a
+	// decision never touches the heap, and the output layer is only evaluated for legal actions.
+	struct Inference
+	{
+		static constexpr int MAX_INPUTS = 64;	// width of Transition::t0/t1
+		static constexpr int MAX_OUTPUTS = 32;
+
+		Matrix<float, INNER_1, Dynamic, ColMajor, INNER_1, MAX_INPUTS> W1;
+		Matrix<float, INNER_1, Dynamic, ColMajor, INNER_1, MAX_INPUTS> W1d;	// columns of W1 for the dense features
+		Matrix<float, INNER_2, Dynamic, ColMajor, INNER_2, INNER_1> W2;	// dynamic cols keeps Eigen on its GEMV kernel
+		Matrix<float, INNER_2, Dynamic, ColMajor, INNER_2, MAX_OUTPUTS> W3t;	// one column per action
+		Matrix<float, INNER_1, 1> b1;
+		Matrix<float, INNER_2, 1> b2;
+		Matrix<float, Dynamic, 1, ColMajor, MAX_OUTPUTS, 1> b3;
+
+		int input_size = 0;
+		int output_size = 0;
+		unsigned int version = 0;	// bumped by set_weights, for caches of its outputs
+
+		// the first layer is a GEMV over the dense (continuous) features plus the sum of the W1 columns
+		// of the 0/1 features that are set
+		int dense[MAX_INPUTS];
+		int flags[MAX_INPUTS];
+		int num_dense = 0;
+		int num_flags = 0;
+
+		void set_features(const std::vector<int>& dense, const std::vector<int>& flags);
+		void set_weights(const MatrixXf& W1, const MatrixXf& W2, const MatrixXf& W3, const MatrixXf& b1, const MatrixXf& b2, const MatrixXf& b3);
+
+		void hidden(const float* state, Matrix<float, INNER_2, 1>& x2) const;
+		void compute(const float* state, float* output) const;
+		int select(const float* state, const std::vector<int>& actions) const;
+
+		template<typename T>
+		void gather_dense(const float* state, T&& x) const
+		{
+			for (int k = 0; k < num_dense; k++)
+				x(k) = state[dense[k]];
+		}
+
+		// the set flags are compacted first, branching on each one costs more than the adds it saves
+		template<typename T>
+		void add_flags(const float* state, T&& x1) const
+		{
+			int active[MAX_INPUTS];
+			int n = 0;
+			for (int k = 0; k < num_flags; k++)
+			{
+				active[n] = flags[k];
+				n += state[flags[k]] != 0.0f;
+			}
+			for (int k = 0; k < n; k++)
+				x1 += W1.col(active[k]);
+		}
+	};
+
 	struct Model
 	{
+		// X0 holds the t1 states of a minibatch in its first batch_size columns and the t0 states in
+		// the last batch_size columns. X0_next is filled with the following minibatch in the meantime.
 		float* x0 = NULL;
 		float* x3 = NULL;
 		float* X0 = NULL;
+		float* X0_next = NULL;
 		float* X3 = NULL;
 		float* target = NULL;
 
@@ -30,7 +94,7 @@ namespace StrikingDummy
 		float* _x1 = NULL;
 		float* _x2 = NULL;
 		float* _x3 = NULL;
-		float* _X0 = NULL;
+		float* _X0 = NULL;		// dense features of X0
 		float* _X1 = NULL;
 		float* _X2 = NULL;
 		float* _X3 = NULL;
@@ -50,6 +114,7 @@ namespace StrikingDummy
 		float* _dLdb1 = NULL;
 		float* _dLdb2 = NULL;
 		float* _dLdb3 = NULL;
+		float* _weights = NULL;
 		float* _ones = NULL;
 
 		float* _dLdW1m = NULL;
@@ -66,6 +131,42 @@ namespace StrikingDummy
 		float* _dLdb3v = NULL;
 		float* _temp = NULL;
 
+		// Layer 1 only sees the dense features of X0 as a matrix. The 0/1 features that are set go to the
+		// device as index lists: per column of X0 the features it has set (active), and per feature the
+		// t0 columns that have it set (samples), which is what the dLdW1 columns of those features sum over.
+		struct Split
+		{
+			float* X0d = NULL;
+			unsigned short* X0h = NULL;		// X0d in reduced precision
+			std::vector<int> active_offsets;
+			std::vector<int> active;
+			std::vector<int> sample_offsets;
+			std::vector<int> samples;
+		};
+
+		std::vector<int> dense;
+		std::vector<int> flags;
+		Split split;		// of X0
+		Split split_next;	// of X0_next
+
+		int* _dense = NULL;
+		int* _flags = NULL;
+		int* _active_offsets = NULL;
+		int* _active = NULL;
+		int* _sample_offsets = NULL;
+		int* _samples = NULL;
+		float* _W1d = NULL;
+		float* _dLdW1d = NULL;
+		float* _dLdW1f = NULL;
+
+		// reduced precision: X0d, the activations and optionally the forward weights are kept in 16 bits
+		unsigned short* _X0h = NULL;
+		unsigned short* _X1h = NULL;
+		unsigned short* _X2h = NULL;
+		unsigned short* _W1h = NULL;
+		unsigned short* _W2h = NULL;
+		unsigned short* _W3h = NULL;
+
 		float* __X0 = NULL;
 		float* __X1 = NULL;
 		float* __X2 = NULL;
@@ -73,8 +174,6 @@ namespace StrikingDummy
 		float* __W3 = NULL;
 
 		MatrixXf m_x0;
-		MatrixXf m_x1;
-		MatrixXf m_x2;
 		MatrixXf m_x3;
 		MatrixXf m_W1;
 		MatrixXf m_W2;
@@ -83,6 +182,8 @@ namespace StrikingDummy
 		MatrixXf m_b2;
 		MatrixXf m_b3;
 
+		Inference inference;
+
 		static constexpr float BETA1 = 0.85f;
 		static constexpr float BETA2 = 0.85f;
 		static constexpr float EPSILON = 0.00000001f;
@@ -93,19 +194,29 @@ namespace StrikingDummy
 		float beta1 = BETA1;
 		float beta2 = BETA2;
 		bool adam = false;
+		Precision precision = Precision::FP32;
+		bool half_weights = false;	// forward pass reads 16-bit copies of the weights, updates still go to the fp32 ones
 
 		//Model(ModelParams& params);
 		~Model();
+		void release();		// frees all host and device buffers, init calls it first
 
-		void init(int input_size, int output_size, int batch_size, bool adam);
+		// flags are the state indices of features that are only ever 0 or 1, the rest are treated as dense
+		void init(int input_size, int output_size, int batch_size, bool adam, const std::vector<int>& flags = std::vector<int>(), Precision precision = Precision::FP32);
 
 		float* compute();
+		// forward pass over X0, which split_batch has to have split since it was last filled
 		float* batch_compute();
+		void swap_batch() { std::swap(X0, X0_next); std::swap(split, split_next); }
 
-		void train(float nu);
+		// splits X0, or X0_next when next, into dense features and active flags. Splitting X0_next only
+		// touches split_next, so it runs on the thread gathering the next minibatch while X0 trains.
+		void split_batch(bool next = false);
+		void train(float nu, float* weights = NULL);
 		void copyToHost();
+		void copy(const Model& other);	// weights and Adam moments of a model with the same shape
 
-		void load(const char* filename);
-		void save(const char* filename);
+		bool load(const char* filename, TrainerState* trainer = NULL);
+		void save(const char* filename, const TrainerState* trainer = NULL);
 	};
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "Rotation.h"
 #include "Job.h"
 #include "Model.h"
+#include "InferenceQueue.h"
+#include "QCache.h"
 #include "BlackMage.h"
 #include <chrono>
 #include <random>
@@ -8,58 +10,56 @@
 
 namespace StrikingDummy
 {
-	std::mt19937 model_rotation_rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
-	std::uniform_real_distribution<float> unif(0.0f, 1.0f);
-	
-	ModelRotation::ModelRotation(Job& job, Model& model) : Rotation(job), model(model)
+	template <typename J>
+	PolicyRotation<J>::PolicyRotation(J& job, Model& model) : Rotation(job), model(model)
 	{
+		// per rotation so that rotations can run on separate threads
+		rng = std::mt19937(std::chrono::high_resolution_clock::now().time_since_epoch().count() + (long long)this);
+		unif = std::uniform_real_distribution<float>(0.0f, 1.0f);
 		random_action.push_back(-1);
 		eps = 0.0f;
 		exp = 0.0f;
 		exploring = false;
 	}
 
-	void ModelRotation::reset(float eps, float exp)
+	template <typename J>
+	void PolicyRotation<J>::reset(float eps, float exp)
 	{
 		this->eps = eps;
 		this->exp = exp;
 		this->exploring = false;
 	}
 
-	void ModelRotation::step()
+	template <typename J>
+	void PolicyRotation<J>::step()
 	{
+		J& job = static_cast<J&>(this->job);
 		if (job.actions.size() == 1)
 			job.use_action(job.actions[0]);
 		else
 		{
 			int action;
-			if (unif(model_rotation_rng) < (exploring ? std::max(eps, exp) : eps))
+			if (unif(rng) < (exploring ? std::max(eps, exp) : eps))
 			{
-				std::sample(job.actions.begin(), job.actions.end(), random_action.begin(), 1, model_rotation_rng);
+				std::sample(job.actions.begin(), job.actions.end(), random_action.begin(), 1, rng);
 				action = random_action.front();
 				exploring = true;
 			}
 			else
 			{
-				memcpy(model.m_x0.data(), job.get_state(), sizeof(float)* job.get_state_size());
-				float* output = model.compute();
-				int max_action = job.actions[0];
-				float max_weight = output[max_action];
-				auto cend = job.actions.cend();
-				for (auto iter = job.actions.cbegin() + 1; iter != cend; iter++)
-				{
-					int index = *iter;
-					if (output[index] > max_weight)
-					{
-						max_weight = output[index];
-						max_action = index;
-					}
-				}
-				action = max_action;
+				if (queue)
+					action = queue->select(job.get_state(), job.actions);
+				else if (cache)
+					action = cache->select(model.inference, job.get_state(), job.actions);
+				else
+					action = model.inference.select(job.get_state(), job.actions);
 				exploring = false;
 			}
 			job.use_action(action);
 		}
-		job.step();
+		job.template advance<J>();
 	}
+
+	template struct PolicyRotation<Job>;
+	template struct PolicyRotation<BlackMage>;
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "OpenerSearch.h"
+#include "Model.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <sstream>
+
+namespace StrikingDummy
+{
+	OpenerSearch::OpenerSearch(int seconds) : horizon(seconds * 1000), nodes(0), pruned(0), transpositions(0), best_damage(0.0f)
+	{
+
+	}
+
+	static uint64_t splitmix(uint64_t z)
+	{
+		z += 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	OpenerSearch::Key OpenerSearch::hash_state(const BlackMage& job)
+	{
+		// two independent 64-bit hashes, so a collision needs both to collide
+		Key key = { 14695981039346656037ull, 0x9E3779B97F4A7C15ull };
+		auto mix = [&key](int field)
+		{
+			key.a = (key.a ^ (uint32_t)field) * 1099511628211ull;
+			key.b = splitmix(key.b + (uint32_t)field);
+		};
+
+		// everything the future of the fight depends on; the damage dealt so far is not part of it
+		for (int field : std::initializer_list<int>{ job.timeline.time, job.mp, job.element, job.umbral_hearts, job.enochian,
+			job.t3p, job.mp_wait, job.skip_lucid_tick, job.xeno_procs, job.casting, job.casting_mp_cost })
+			mix(field);
+		for (const Timer* timer : { &job.mp_timer, &job.dot_timer, &job.lucid_timer, &job.xeno_timer,
+			&job.swift_cd, &job.triple_cd, &job.sharp_cd, &job.leylines_cd, &job.manafont_cd, &job.eno_cd,
+			&job.transpose_cd, &job.lucid_cd, &job.pot_cd, &job.gcd_timer, &job.cast_timer, &job.action_timer })
+		{
+			mix(timer->time);
+			mix(timer->ready);
+		}
+		for (const Buff* buff : { &job.gauge, &job.swift, &job.sharp, &job.triple, &job.leylines,
+			&job.fs_proc, &job.tc_proc, &job.dot, &job.lucid, &job.pot })
+		{
+			mix(buff->time);
+			mix(buff->count);
+		}
+
+		// pending events decide where the next decision points are. Their heap layout depends on the
+		// order they were pushed in, so they go in as a sum, which does not.
+		uint64_t events = 0;
+		for (int event : job.timeline.pending())
+			events += splitmix((uint32_t)event);
+		mix((int)events);
+		mix((int)(events >> 32));
+		return key;
+	}
+
+	float OpenerSearch::upper_bound(const BlackMage& job) const
+	{
+		int t = job.timeline.time;
+
+		// a GCD started before the horizon lands before the leaf, one started after it is not counted,
+		// so the hits still to come are the cast in flight plus GCD starts left before the horizon
+		int first_start = t + (job.gcd_timer.ready ? 0 : job.gcd_timer.time);
+		int hits = (job.casting != BlackMage::NONE) + (first_start < horizon ? (horizon - first_start - 1) / min_recast + 1 : 0);
+
+		// Xenoglossy needs a proc and every Despair after the first needs an MP refill,
+		// from Manafont or at the earliest a server tick; everything else is at most an AF3 Fire IV
+		int remaining = horizon - t;
+		int xenos = std::min(hits, job.xeno_procs + (job.enochian || job.eno_cd.ready ? remaining / BlackMage::XENO_TIMER + 1 : 0));
+		int despairs = std::min(hits - xenos, 1 + job.manafont_cd.ready + remaining / BlackMage::TICK_TIMER);
+		int others = hits - xenos - despairs;
+
+		float multiplier = job.pot.count > 0 || job.pot_cd.ready ? max_multiplier : max_multiplier / pot_multiplier;
+		// a dot keeps the potion it was applied under, so it ticks at full strength after the potion wears off
+		float dot_multiplier = job.dot.count & 4 ? max_multiplier : multiplier;
+		float damage = multiplier * (xenos * BlackMage::XENO_POTENCY +
+			despairs * BlackMage::DESPAIR_POTENCY * BlackMage::AF3_MULTIPLIER +
+			others * BlackMage::F4_POTENCY * BlackMage::AF3_MULTIPLIER);
+
+		// a fully buffed dot tick on every server tick until the latest possible leaf
+		int ticks = (remaining + job.iii_gcd) / BlackMage::TICK_TIMER + 1;
+		damage += ticks * dot_multiplier * max_dot_potency;
+
+		return job.total_damage + damage;
+	}
+
+	bool OpenerSearch::visit(const BlackMage& job)
+	{
+		Key key = hash_state(job);
+		Shard& shard = shards[key.b % NUM_SHARDS];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Entry& entry = shard.table[key.a & slot_mask];
+		if (entry.key == key)
+		{
+			// same state reached before with at least as much damage: nothing new below here
+			if (entry.damage >= job.total_damage)
+				return false;
+		}
+		else
+			entry.key = key;
+		entry.damage = job.total_damage;
+		return true;
+	}
+
+	void OpenerSearch::order_actions(const BlackMage& job, std::vector<int>& actions, size_t depth) const
+	{
+		actions = job.actions;
+		if (!policy || (int)depth >= order_depth)
+			return;
+		float q[Inference::MAX_OUTPUTS];
+		policy->compute(job.history.back().t0, q);
+		std::stable_sort(actions.begin(), actions.end(), [&](int a, int b) { return q[a] > q[b]; });
+	}
+
+	void OpenerSearch::offer(const BlackMage& job, const std::vector<Step>& path)
+	{
+		std::lock_guard<std::mutex> lock(best_mutex);
+		if (job.total_damage > best.damage)
+		{
+			best.damage = job.total_damage;
+			best.steps = path;
+			best_damage = job.total_damage;
+		}
+	}
+
+	static void advance(BlackMage& job, int action)
+	{
+		job.use_action(action);
+		job.advance<BlackMage>();
+		// only the last transition is ever touched again, and short histories keep copies cheap
+		if (job.history.size() > 1)
+			job.history.erase(job.history.begin(), job.history.end() - 1);
+	}
+
+	void OpenerSearch::expand(const BlackMage& job, std::vector<Step>& path)
+	{
+		nodes++;
+		if (job.timeline.time >= horizon)
+		{
+			if (job.total_damage > best_damage)
+				offer(job, path);
+			return;
+		}
+		if (upper_bound(job) <= best_damage)
+		{
+			pruned++;
+			return;
+		}
+		if (!visit(job))
+		{
+			transpositions++;
+			return;
+		}
+
+		std::vector<int> actions;
+		order_actions(job, actions, path.size());
+		for (int action : actions)
+		{
+			BlackMage next(job);
+			path.push_back({ job.timeline.time, action });
+			advance(next, action);
+			expand(next, path);
+			path.pop_back();
+		}
+	}
+
+	OpenerSearch::Result OpenerSearch::rollout(const BlackMage& start, const Inference& policy)
+	{
+		BlackMage job(start);
+		Result result;
+		while (job.timeline.time < horizon)
+		{
+			int action = policy.select(job.get_state(), job.actions);
+			result.steps.push_back({ job.timeline.time, action });
+			advance(job, action);
+		}
+		result.damage = job.total_damage;
+		return result;
+	}
+
+	OpenerSearch::Result OpenerSearch::search(const BlackMage& start, const Inference* policy)
+	{
+		this->policy = policy;
+		nodes = 0;
+		pruned = 0;
+		transpositions = 0;
+		size_t shard_size = 1;
+		while (shard_size * NUM_SHARDS < (size_t)table_size)
+			shard_size <<= 1;
+		slot_mask = shard_size - 1;
+		for (Shard& shard : shards)
+			shard.table.assign(shard_size, Entry());
+
+		const Stats& stats = start.stats;
+		pot_multiplier = std::max(stats.pot_multiplier, 1.0f);
+		max_multiplier = stats.potency_multiplier * stats.expected_multiplier * BlackMage::ENO_MULTIPLIER * pot_multiplier * BlackMage::MAGICK_AND_MEND_MULTIPLIER;
+		max_dot_potency = BlackMage::T3_DOT_POTENCY * stats.dot_multiplier;
+		min_recast = std::min(start.ll_base_gcd, start.base_gcd);
+
+		best = Result();
+		if (policy)
+			best = rollout(start, *policy);
+		best_damage = best.damage;
+
+		// expand the first few decisions here, then search the subtrees below them in parallel
+		struct Task
+		{
+			BlackMage job;
+			std::vector<Step> path;
+		};
+		std::vector<Task> frontier;
+		frontier.push_back({ start, {} });
+		for (int depth = 0; depth < split_depth; depth++)
+		{
+			std::vector<Task> next;
+			for (Task& task : frontier)
+			{
+				if (task.job.timeline.time >= horizon)
+				{
+					next.push_back(task);
+					continue;
+				}
+				std::vector<int> actions;
+				order_actions(task.job, actions, depth);
+				for (int action : actions)
+				{
+					Task child = { task.job, task.path };
+					child.path.push_back({ task.job.timeline.time, action });
+					advance(child.job, action);
+					next.push_back(child);
+				}
+			}
+			frontier.swap(next);
+		}
+
+		parallel_for(frontier.size(), [&](int i)
+		{
+			std::vector<Step> path = frontier[i].path;
+			expand(frontier[i].job, path);
+		}, num_threads);
+
+		return best;
+	}
+
+	std::string OpenerSearch::format(BlackMage& job, const Result& result)
+	{
+		std::stringstream ss;
+		ss << "damage: " << result.damage << std::endl;
+		for (const Step& step : result.steps)
+		{
+			if (step.action == BlackMage::NONE)
+				continue;
+			int seconds = step.time / 1000;
+			int centiseconds = (step.time % 1000) / 10;
+			ss << "[" << seconds << "." << (centiseconds < 10 ? "0" : "") << centiseconds << "] " << job.get_action_name(step.action) << std::endl;
+		}
+		return ss.str();
+	}
+}
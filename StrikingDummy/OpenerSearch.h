@@ -0,0 +1,90 @@
+#pragma once
+
+#include "BlackMage.h"
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace StrikingDummy
+{
+	struct Inference;
+
+	// Exhaustive search for the opener that deals the most damage in the first horizon ms of a fight
+	// without random procs. Damage is counted up to the first decision point at or after the horizon.
+	// The start state must be deterministic: random_procs off and server ticks fixed by seeding the job
+	// before reset. With procs on the best opener can differ, Firestarter and Thundercloud procs are
+	// neither sampled nor taken in expectation.
+	struct OpenerSearch
+	{
+		struct Step
+		{
+			int time;
+			int action;
+		};
+
+		struct Result
+		{
+			float damage = 0.0f;
+			std::vector<Step> steps;
+		};
+
+		int horizon;
+		int num_threads = 0;	// all cores
+		int split_depth = 3;	// decisions expanded up front to hand out as separate tasks
+		int order_depth = 8;	// deeper than this the policy forward pass costs more than the pruning it buys
+		int table_size = 1 << 22;	// transposition table entries (24 bytes each), a new state replaces whatever held its slot
+
+		std::atomic<long long> nodes;
+		std::atomic<long long> pruned;
+		std::atomic<long long> transpositions;
+
+		OpenerSearch(int seconds);
+
+		// policy is optional: its greedy opener seeds the bound and its Q values order the branches
+		Result search(const BlackMage& start, const Inference* policy);
+		Result rollout(const BlackMage& start, const Inference& policy);
+
+		static std::string format(BlackMage& job, const Result& result);
+
+	private:
+		struct Key
+		{
+			uint64_t a, b;
+			bool operator==(const Key& other) const { return a == other.a && b == other.b; }
+		};
+		struct Entry
+		{
+			Key key;		// { 0, 0 } <=> empty
+			float damage;
+		};
+
+		// best damage seen on arrival at each state, direct mapped and sharded to keep lock contention
+		// down. Losing an entry to a replacement only costs searching that state again.
+		static constexpr int NUM_SHARDS = 64;
+		struct Shard
+		{
+			std::mutex mutex;
+			std::vector<Entry> table;
+		};
+		Shard shards[NUM_SHARDS];
+		uint64_t slot_mask = 0;
+
+		std::mutex best_mutex;
+		std::atomic<float> best_damage;
+		Result best;
+
+		const Inference* policy = NULL;
+		float max_multiplier = 0.0f;
+		float pot_multiplier = 1.0f;
+		float max_dot_potency = 0.0f;
+		int min_recast = 0;
+
+		static Key hash_state(const BlackMage& job);
+		float upper_bound(const BlackMage& job) const;
+		bool visit(const BlackMage& job);
+		void order_actions(const BlackMage& job, std::vector<int>& actions, size_t depth) const;
+		void expand(const BlackMage& job, std::vector<Step>& path);
+		void offer(const BlackMage& job, const std::vector<Step>& path);
+	};
+}
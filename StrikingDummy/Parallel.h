@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace StrikingDummy
+{
+	// threads parallel_for runs n items on
+	inline int thread_count(int n, int num_threads = 0)
+	{
+		if (num_threads <= 0)
+			num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+		return std::min(num_threads, n);
+	}
+
+	// Calls f(i) for i in [0, n) on num_threads threads (all cores by default). Items are handed out
+	// one at a time, so uneven items still balance.
+	template <typename F>
+	void parallel_for(int n, F f, int num_threads = 0)
+	{
+		num_threads = thread_count(n, num_threads);
+
+		std::atomic<int> next(0);
+		auto worker = [&]()
+		{
+			for (int i = next++; i < n; i = next++)
+				f(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (int t = 1; t < num_threads; t++)
+			threads.emplace_back(worker);
+		worker();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
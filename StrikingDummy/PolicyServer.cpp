@@ -0,0 +1,264 @@
+#include "PolicyServer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+typedef SOCKET socket_t;
+#define SEND_FLAGS 0
+#define SHUT_RDWR SD_BOTH
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int socket_t;
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+namespace StrikingDummy
+{
+	namespace
+	{
+		const char POLICY_MAGIC[8] = { 'S', 'D', 'P', 'O', 'L', 'I', 'C', 'Y' };
+
+		void close_socket(intptr_t s)
+		{
+#ifdef _WIN32
+			closesocket((socket_t)s);
+#else
+			close((socket_t)s);
+#endif
+		}
+
+		bool read_all(intptr_t s, void* data, size_t size)
+		{
+			char* p = (char*)data;
+			while (size > 0)
+			{
+				int n = (int)recv((socket_t)s, p, (int)size, 0);
+				if (n <= 0)
+					return false;
+				p += n;
+				size -= n;
+			}
+			return true;
+		}
+
+		bool write_all(intptr_t s, const void* data, size_t size)
+		{
+			const char* p = (const char*)data;
+			while (size > 0)
+			{
+				int n = (int)send((socket_t)s, p, (int)size, SEND_FLAGS);
+				if (n <= 0)
+					return false;
+				p += n;
+				size -= n;
+			}
+			return true;
+		}
+	}
+
+	double PolicyServer::Statistics::percentile(double p) const
+	{
+		long long total = 0;
+		for (long long n : latency)
+			total += n;
+		long long rank = (long long)(p * total);
+		long long seen = 0;
+		for (size_t us = 0; us < latency.size(); us++)
+		{
+			seen += latency[us];
+			if (seen > rank)
+				return (double)us;
+		}
+		return (double)latency.size();
+	}
+
+	PolicyServer::PolicyServer(const Inference& inference, int max_batch, int max_latency) :
+		inference(inference), queue(inference, max_batch, max_latency), running(false)
+	{
+		statistics.latency.resize(MAX_LATENCY_US + 1);
+#ifdef _WIN32
+		WSADATA wsa;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+			std::cerr << "WSAStartup failed" << std::endl;
+#endif
+	}
+
+	PolicyServer::~PolicyServer()
+	{
+		stop();
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	bool PolicyServer::start(const char* path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(address.sun_path))
+		{
+			std::cerr << path << " is too long for a socket path" << std::endl;
+			return false;
+		}
+		strcpy(address.sun_path, path);
+
+		// a socket file left behind by a server that did not stop cleanly would make bind fail
+		remove(path);
+
+		intptr_t s = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s == -1)
+		{
+			std::cerr << "socket failed" << std::endl;
+			return false;
+		}
+		if (bind((socket_t)s, (sockaddr*)&address, sizeof(address)) != 0 || listen((socket_t)s, 16) != 0)
+		{
+			std::cerr << "could not listen on " << path << std::endl;
+			close_socket(s);
+			return false;
+		}
+
+		this->path = path;
+		listener = s;
+		running = true;
+		acceptor = std::thread(&PolicyServer::accept_loop, this);
+		return true;
+	}
+
+	void PolicyServer::stop()
+	{
+		if (!running.exchange(false))
+			return;
+
+		// shutdown wakes up the threads blocked on a socket
+		shutdown((socket_t)listener, SHUT_RDWR);
+		close_socket(listener);
+		acceptor.join();
+		listener = -1;
+
+		std::vector<std::thread> remaining;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (intptr_t client : clients)
+				shutdown((socket_t)client, SHUT_RDWR);
+			remaining.swap(workers);
+		}
+		for (std::thread& worker : remaining)
+			worker.join();
+		finished.clear();
+
+		remove(path.c_str());
+	}
+
+	PolicyServer::Statistics PolicyServer::get_statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+
+	void PolicyServer::accept_loop()
+	{
+		int backoff_ms = 0;
+		while (running)
+		{
+			reap_workers();
+
+			intptr_t client = (intptr_t)accept((socket_t)listener, NULL, NULL);
+			if (client == -1)
+			{
+				if (!running)
+					return;
+				// errors like EMFILE persist until a connection closes, retrying at once would spin
+				backoff_ms = std::min(std::max(2 * backoff_ms, 1), MAX_BACKOFF_MS);
+				std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+				continue;
+			}
+			backoff_ms = 0;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!running)
+			{
+				close_socket(client);
+				return;
+			}
+			statistics.connections++;
+			clients.push_back(client);
+			queue.set_producers((int)clients.size());
+			workers.emplace_back(&PolicyServer::serve, this, client);
+		}
+	}
+
+	void PolicyServer::reap_workers()
+	{
+		std::vector<std::thread> done;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::thread::id id : finished)
+			{
+				auto it = std::find_if(workers.begin(), workers.end(), [id](const std::thread& t) { return t.get_id() == id; });
+				done.push_back(std::move(*it));
+				workers.erase(it);
+			}
+			finished.clear();
+		}
+		// a finished worker has nothing left to do after releasing the mutex, so these joins return at once
+		for (std::thread& worker : done)
+			worker.join();
+	}
+
+	void PolicyServer::serve(intptr_t client)
+	{
+		int input_size = inference.input_size;
+		int output_size = inference.output_size;
+
+		Hello hello;
+		memcpy(hello.magic, POLICY_MAGIC, sizeof(POLICY_MAGIC));
+		hello.version = VERSION;
+		hello.input_size = input_size;
+		hello.output_size = output_size;
+
+		// request and response are each read and written with a single call
+		alignas(float) char request[sizeof(uint32_t) + sizeof(float) * Inference::MAX_INPUTS];
+		alignas(float) char response[sizeof(int32_t) + sizeof(float) * Inference::MAX_OUTPUTS];
+		size_t request_size = sizeof(uint32_t) + sizeof(float) * input_size;
+		size_t response_size = sizeof(int32_t) + sizeof(float) * output_size;
+		float* state = (float*)(request + sizeof(uint32_t));
+		float* output = (float*)(response + sizeof(int32_t));
+
+		bool open = write_all(client, &hello, sizeof(hello));
+		while (open && read_all(client, request, request_size))
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			uint32_t legal;
+			memcpy(&legal, request, sizeof(legal));
+			queue.compute(state, output);
+
+			int32_t action = -1;
+			for (int i = 0; i < output_size; i++)
+				if (((legal >> i) & 1) && (action < 0 || output[i] > output[action]))
+					action = i;
+			memcpy(response, &action, sizeof(action));
+			open = write_all(client, response, response_size);
+
+			long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.requests++;
+			statistics.latency[std::min(us, (long long)MAX_LATENCY_US)]++;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		clients.erase(std::find(clients.begin(), clients.end(), client));
+		queue.set_producers((int)clients.size());
+		close_socket(client);
+		finished.push_back(std::this_thread::get_id());
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "InferenceQueue.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Answers policy queries from other processes over a Unix domain socket (AF_UNIX, which Windows has
+	// since 10 1803). Each connection is served by its own thread and all of them share one InferenceQueue,
+	// so requests arriving together are answered by one batched forward pass.
+	//
+	// Protocol, native byte order, one request at a time per connection:
+	//   on connect the server sends a Hello
+	//   request:  uint32 legal mask (bit i set <=> action i may be chosen), input_size floats of state
+	//   response: int32 best legal action (-1 for an empty mask), output_size floats of network output
+	struct PolicyServer
+	{
+		struct Hello
+		{
+			char magic[8];		// "SDPOLICY"
+			uint32_t version;
+			uint32_t input_size;
+			uint32_t output_size;
+		};
+
+		static constexpr uint32_t VERSION = 1;
+		static constexpr int MAX_LATENCY_US = 1000;
+		static constexpr int MAX_BACKOFF_MS = 100;
+
+		struct Statistics
+		{
+			long long connections = 0;
+			long long requests = 0;
+			std::vector<long long> latency;	// histogram in us from reading a request to sending its response, the last bucket collects the rest
+
+			double percentile(double p) const;
+		};
+
+		// max_latency is how long, in us, a request waits for others to batch with
+		PolicyServer(const Inference& inference, int max_batch = 32, int max_latency = 20);
+		~PolicyServer();
+
+		bool start(const char* path);
+		void stop();
+
+		Statistics get_statistics();
+		InferenceQueue::Statistics get_batching() { return queue.get_statistics(); }
+
+	private:
+		const Inference& inference;
+		InferenceQueue queue;
+
+		std::string path;
+		intptr_t listener = -1;		// SOCKET on Windows, file descriptor elsewhere
+		std::atomic<bool> running;
+		std::thread acceptor;
+
+		std::mutex mutex;
+		std::vector<intptr_t> clients;
+		std::vector<std::thread> workers;
+		std::vector<std::thread::id> finished;	// workers whose connection closed, joined by the next accept
+		Statistics statistics;
+
+		void accept_loop();
+		void reap_workers();
+		void serve(intptr_t client);
+	};
+}
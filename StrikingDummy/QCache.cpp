@@ -0,0 +1,67 @@
+#include "QCache.h"
+#include <cmath>
+
+namespace StrikingDummy
+{
+	QCache::QCache(int capacity, float resolution) : resolution(resolution)
+	{
+		int size = 1;
+		while (size < capacity)
+			size <<= 1;
+		entries.resize(size);
+		mask = size - 1;
+	}
+
+	uint64_t QCache::hash(const float* state, int size) const
+	{
+		// FNV-1a over the rounded features, then a finalizer so the low bits that pick the slot are mixed
+		uint64_t h = 14695981039346656037ull;
+		for (int i = 0; i < size; i++)
+		{
+			h ^= (uint32_t)lrintf(state[i] * resolution);
+			h *= 1099511628211ull;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		return h != 0 ? h : 1;
+	}
+
+	void QCache::clear()
+	{
+		for (Entry& entry : entries)
+			entry.key = 0;
+	}
+
+	const float* QCache::compute(const Inference& inference, const float* state)
+	{
+		if (owner != &inference || version != inference.version)
+		{
+			clear();
+			owner = &inference;
+			version = inference.version;
+		}
+
+		uint64_t key = hash(state, inference.input_size);
+		Entry& entry = entries[key & mask];
+		if (entry.key == key)
+		{
+			hits++;
+			return entry.output;
+		}
+		misses++;
+		inference.compute(state, entry.output);
+		entry.key = key;
+		return entry.output;
+	}
+
+	int QCache::select(const Inference& inference, const float* state, const std::vector<int>& actions)
+	{
+		const float* output = compute(inference, state);
+		int max_action = actions[0];
+		for (int action : actions)
+			if (output[action] > output[max_action])
+				max_action = action;
+		return max_action;
+	}
+}
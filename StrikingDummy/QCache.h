@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Model.h"
+#include <stdint.h>
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Bounded memo of network outputs in front of Inference, for analysis runs that revisit states. A state
+	// is keyed by a 64-bit hash of its features rounded to multiples of 1/resolution, so states closer than
+	// that share outputs and a cached run can decide differently from an uncached one. Direct mapped: a new state evicts whatever
+	// held its slot. Entries are dropped when the weights they were computed with change.
+	struct QCache
+	{
+		struct Entry
+		{
+			uint64_t key = 0;	// 0 <=> empty
+			float output[Inference::MAX_OUTPUTS];
+		};
+
+		long long hits = 0;
+		long long misses = 0;
+
+		// capacity is rounded up to a power of 2
+		QCache(int capacity = 1 << 16, float resolution = 4096.0f);
+
+		const float* compute(const Inference& inference, const float* state);
+		int select(const Inference& inference, const float* state, const std::vector<int>& actions);
+		void clear();
+
+		double hit_rate() const { return hits + misses > 0 ? (double)hits / (hits + misses) : 0.0; }
+
+	private:
+		std::vector<Entry> entries;
+		uint64_t mask;
+		float resolution;
+		const Inference* owner = NULL;
+		unsigned int version = 0;
+
+		uint64_t hash(const float* state, int size) const;
+	};
+}
@@ -0,0 +1,185 @@
+#include "ReplayMemory.h"
+#include "Memory.h"
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace StrikingDummy
+{
+	static_assert(std::is_trivially_copyable<Transition>::value, "transitions are stored in raw memory");
+
+	const char REPLAY_MAGIC[8] = { 'S', 'D', 'R', 'E', 'P', 'L', 'A', 'Y' };
+
+	ReplayMemory::~ReplayMemory()
+	{
+		close();
+	}
+
+	void ReplayMemory::init(int capacity, bool use_large_pages)
+	{
+		close();
+
+		this->capacity = capacity;
+		index = 0;
+		size = 0;
+		bytes = sizeof(Transition) * (size_t)capacity;
+
+		void* p = NULL;
+#ifdef _WIN32
+		// needs SeLockMemoryPrivilege, otherwise fall back to regular pages
+		size_t large_page = GetLargePageMinimum();
+		if (use_large_pages && large_page)
+		{
+			size_t large_bytes = (bytes + large_page - 1) / large_page * large_page;
+			p = VirtualAlloc(NULL, large_bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			large_pages = p != NULL;
+			if (large_pages)
+				bytes = large_bytes;
+		}
+		if (!p)
+			p = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			p = NULL;
+#ifdef MADV_HUGEPAGE
+		else if (use_large_pages)
+			large_pages = madvise(p, bytes, MADV_HUGEPAGE) == 0;
+#endif
+#endif
+		if (!p)
+		{
+			std::cerr << "ReplayMemory allocation of " << bytes << " bytes failed" << std::endl;
+			throw 0;
+		}
+
+		// fresh pages are zeroed, which is a valid empty transition
+		view = p;
+		memory = (Transition*)p;
+		Memory::allocated(MemoryTag::REPLAY, bytes);
+	}
+
+	void ReplayMemory::open(const char* filename, int capacity, int state_size)
+	{
+		close();
+
+		this->capacity = capacity;
+		bytes = HEADER_SIZE + sizeof(Transition) * (size_t)capacity;
+		if (!file.open(filename, true, bytes))
+		{
+			std::cerr << "Mapping " << filename << " failed" << std::endl;
+			throw 0;
+		}
+		size_t existing = file.existing_size;
+		view = file.data;
+		Memory::allocated(MemoryTag::REPLAY_MAPPED, bytes);
+#ifndef _WIN32
+		// minibatches are gathered at random, so readahead only wastes page cache
+		madvise(view, bytes, MADV_RANDOM);
+#endif
+
+		header = (Header*)view;
+		memory = (Transition*)((char*)view + HEADER_SIZE);
+
+		bool valid = existing == bytes &&
+			memcmp(header->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) == 0 &&
+			header->version == VERSION &&
+			header->state_size == state_size &&
+			header->transition_size == (int)sizeof(Transition) &&
+			header->capacity == capacity &&
+			header->index >= 0 && header->index < capacity &&
+			header->size >= 0 && header->size <= capacity;
+
+		if (valid)
+		{
+			index = header->index;
+			size = header->size;
+		}
+		else
+		{
+			memcpy(header->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+			header->version = VERSION;
+			header->state_size = state_size;
+			header->transition_size = sizeof(Transition);
+			header->capacity = capacity;
+			header->index = index = 0;
+			header->size = size = 0;
+		}
+	}
+
+	void ReplayMemory::close()
+	{
+		if (!view)
+			return;
+		if (file.is_open())
+		{
+			file.close();
+			Memory::freed(MemoryTag::REPLAY_MAPPED, bytes);
+		}
+		else
+		{
+#ifdef _WIN32
+			VirtualFree(view, 0, MEM_RELEASE);
+#else
+			munmap(view, bytes);
+#endif
+			Memory::freed(MemoryTag::REPLAY, bytes);
+		}
+		view = NULL;
+		memory = NULL;
+		header = NULL;
+	}
+
+	void ReplayMemory::sort(std::vector<int>& indices) const
+	{
+		// counting sort on 4096-slot buckets: O(n), and enough to walk memory front to back
+		const int SHIFT = 12;
+		std::vector<int> counts((capacity >> SHIFT) + 2, 0);
+		std::vector<int> sorted(indices.size());
+		for (int i : indices)
+			counts[(i >> SHIFT) + 1]++;
+		for (int i = 1; i < (int)counts.size(); i++)
+			counts[i] += counts[i - 1];
+		for (int i : indices)
+			sorted[counts[i >> SHIFT]++] = i;
+		indices.swap(sorted);
+	}
+
+	int ReplayMemory::push(const Transition& t)
+	{
+		int slot = index;
+		memory[slot] = t;
+		index++;
+		if (index == capacity)
+			index = 0;
+		if (size < capacity)
+			size++;
+		if (header)
+		{
+			header->index = index;
+			header->size = size;
+		}
+		return slot;
+	}
+
+	bool ReplayMemory::rewind(int index, int size)
+	{
+		if (index < 0 || index >= capacity || size < 0 || size > this->size)
+			return false;
+		this->index = index;
+		this->size = size;
+		if (header)
+		{
+			header->index = index;
+			header->size = size;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Job.h"
+#include "MappedFile.h"
+#include <stdint.h>
+#include <vector>
+#include <xmmintrin.h>
+
+namespace StrikingDummy
+{
+	// Ring buffer of transitions for experience replay. It is either an anonymous allocation,
+	// optionally on large pages to cut TLB misses during the random minibatch gather, or a
+	// memory-mapped file that survives restarts and can hold more transitions than fit in RAM.
+	struct ReplayMemory
+	{
+		// first page of a replay file; transitions start at HEADER_SIZE
+		struct Header
+		{
+			char magic[8];
+			int version;
+			int state_size;
+			int transition_size;
+			int capacity;
+			int index;
+			int size;
+		};
+
+		static constexpr int VERSION = 1;
+		static constexpr int HEADER_SIZE = 4096;
+
+		Transition* memory = NULL;
+		int capacity = 0;
+		int index = 0;
+		int size = 0;
+		bool large_pages = false;
+
+		~ReplayMemory();
+
+		void init(int capacity, bool use_large_pages);
+		void open(const char* filename, int capacity, int state_size);
+		void close();
+
+		int push(const Transition& t);
+		// moves the write position back, dropping everything pushed since index and size were read
+		bool rewind(int index, int size);
+		bool full() const { return size == capacity; }
+
+		Transition& operator[](int i) { return memory[i]; }
+
+		void sort(std::vector<int>& indices) const;
+
+		// pull the parts of a transition read by the minibatch gather into cache
+		void prefetch(int i) const
+		{
+			const char* t = (const char*)&memory[i];
+			for (int offset = 0; offset < (int)sizeof(Transition); offset += 64)
+				_mm_prefetch(t + offset, _MM_HINT_T0);
+		}
+
+	private:
+		Header* header = NULL;
+		void* view = NULL;
+		size_t bytes = 0;
+		MappedFile file;
+	};
+}
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <random>
 #include <vector>
 
 namespace StrikingDummy
 {
 	struct Job;
+	struct BlackMage;
 	struct Model;
+	struct InferenceQueue;
+	struct QCache;
+	struct DecisionTree;
 
 	struct Rotation
 	{
@@ -16,21 +21,42 @@ namespace StrikingDummy
 		virtual void step() = 0;
 	};
 
-	struct ModelRotation : Rotation
+	// Rotation that follows a trained model. J is the job type it drives: for a final job such as
+	// BlackMage every call in step is resolved statically, ModelRotation works through the Job interface.
+	template <typename J>
+	struct PolicyRotation final : Rotation
 	{
 		Model& model;
+		InferenceQueue* queue = NULL;	// route decisions through a shared batching queue when set
+		QCache* cache = NULL;			// otherwise through a cache of outputs when set
 		std::vector<int> random_action;
+		std::mt19937 rng;
+		std::uniform_real_distribution<float> unif;
 		float eps;
 		float exp;
 		bool exploring;
 
-		ModelRotation(Job& job, Model& model);
+		PolicyRotation(J& job, Model& model);
 
 		void reset(float eps, float exp);
 		void step();
 	};
 
+	using ModelRotation = PolicyRotation<Job>;
+	using BlackMageRotation = PolicyRotation<BlackMage>;
 
+	// Rotation that follows a decision tree distilled from a trained model, see TrainingDummy::distill.
+	template <typename J>
+	struct TreeRotation final : Rotation
+	{
+		const DecisionTree& tree;
+
+		TreeRotation(J& job, const DecisionTree& tree);
+
+		void step();
+	};
+
+	using BlackMageTreeRotation = TreeRotation<BlackMage>;
 
 	struct MyRotation : Rotation
 	{
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+
+namespace StrikingDummy
+{
+	// Streaming mean and variance (Welford). Partial results from separate threads combine with merge.
+	struct RunningStat
+	{
+		long long count = 0;
+		double mean = 0.0;
+		double m2 = 0.0;
+
+		void add(double x)
+		{
+			count++;
+			double delta = x - mean;
+			mean += delta / count;
+			m2 += delta * (x - mean);
+		}
+
+		void merge(const RunningStat& other)
+		{
+			if (other.count == 0)
+				return;
+			long long total = count + other.count;
+			double delta = other.mean - mean;
+			mean += delta * other.count / total;
+			m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+			count = total;
+		}
+
+		double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+		double stddev() const { return std::sqrt(variance()); }
+
+		// half width of the normal approximation 95% confidence interval of the mean
+		double ci95() const { return count > 1 ? 1.96 * stddev() / std::sqrt((double)count) : 0.0; }
+	};
+}
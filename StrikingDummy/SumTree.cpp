@@ -0,0 +1,44 @@
+#include "SumTree.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace StrikingDummy
+{
+	void SumTree::init(int capacity)
+	{
+		this->capacity = capacity;
+		leaves = 1;
+		while (leaves < capacity)
+			leaves <<= 1;
+		nodes.assign(2 * leaves, 0.0f);
+		max_priority = 1.0f;
+	}
+
+	void SumTree::update(int index, float priority)
+	{
+		assert(index >= 0 && index < capacity);
+		max_priority = std::max(max_priority, priority);
+		int node = leaves + index;
+		nodes[node] = priority;
+		// recompute rather than add deltas so rounding errors do not accumulate
+		for (node >>= 1; node > 0; node >>= 1)
+			nodes[node] = nodes[node << 1] + nodes[(node << 1) + 1];
+	}
+
+	int SumTree::find(float value) const
+	{
+		int node = 1;
+		while (node < leaves)
+		{
+			int left = node << 1;
+			if (value < nodes[left] || nodes[left + 1] == 0.0f)
+				node = left;
+			else
+			{
+				value -= nodes[left];
+				node = left + 1;
+			}
+		}
+		return std::min(node - leaves, capacity - 1);
+	}
+}
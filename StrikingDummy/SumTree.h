@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+namespace StrikingDummy
+{
+	// Binary tree over transition priorities where every node holds the sum of its children.
+	// Updating a priority and finding the leaf at a given prefix sum are both O(log n).
+	struct SumTree
+	{
+		int capacity = 0;
+		int leaves = 0;
+		std::vector<float> nodes;
+		float max_priority = 1.0f;
+
+		void init(int capacity);
+
+		void update(int index, float priority);
+		float get(int index) const { return nodes[leaves + index]; }
+		float total() const { return nodes[1]; }
+
+		int find(float value) const;
+	};
+}
@@ -1,13 +1,130 @@
 #include "TrainingDummy.h"
+#include "ActionScript.h"
 #include "BlackMage.h"
+#include "DecisionTree.h"
+#include "Evaluator.h"
+#include "OpenerSearch.h"
+#include "PolicyServer.h"
 #include "Logger.h"
+#include "Memory.h"
+#include "Parallel.h"
+#include "QCache.h"
+#include "ReplayMemory.h"
+#include "Statistics.h"
+#include "SumTree.h"
+#include <cfloat>
+#include <emmintrin.h>
 #include <chrono>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <random>
 
 namespace StrikingDummy
 {
-	TrainingDummy::TrainingDummy(Job& job) : job(job), rotation(job, model)
+	// max_q[i] = max of Q[i * num_actions + a] over the actions a set in legal[i], four actions at a time
+	static void masked_max(const float* Q, const unsigned int* legal, int num_actions, int batch_size, float* max_q)
+	{
+		const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+		const __m128 lowest = _mm_set1_ps(-FLT_MAX);
+		for (int i = 0; i < batch_size; i++)
+		{
+			const float* q = &Q[i * num_actions];
+			__m128 best = lowest;
+			int a = 0;
+			for (; a + 4 <= num_actions; a += 4)
+			{
+				__m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(legal[i] >> a), bits), bits));
+				__m128 values = _mm_or_ps(_mm_and_ps(mask, _mm_loadu_ps(q + a)), _mm_andnot_ps(mask, lowest));
+				best = _mm_max_ps(best, values);
+			}
+			best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+			best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+			float m = _mm_cvtss_f32(best);
+			for (; a < num_actions; a++)
+				if (((legal[i] >> a) & 1) && q[a] > m)
+					m = q[a];
+			max_q[i] = m;
+		}
+	}
+
+	// minibatch k + 1 is gathered on a helper thread while minibatch k trains
+	struct Minibatch
+	{
+		std::vector<int> indices;
+		std::vector<int> actions;
+		std::vector<float> rewards;
+		std::vector<float> dts;
+		std::vector<unsigned int> legal;
+		std::vector<float> weights;
+
+		void resize(int batch_size)
+		{
+			indices.resize(batch_size);
+			actions.resize(batch_size);
+			rewards.resize(batch_size);
+			dts.resize(batch_size);
+			legal.resize(batch_size);
+			weights.resize(batch_size);
+		}
+	};
+
+	// copies the transitions at mb.indices into mb and X0, t1 states in the first batch_size columns
+	// and t0 states in the last batch_size columns
+	static void gather(ReplayMemory& memory, Minibatch& mb, float* X0, int state_size, int prefetch_distance)
+	{
+		int batch_size = mb.indices.size();
+
+		// walk memory in address order; the order of samples within a minibatch is irrelevant
+		memory.sort(mb.indices);
+
+		for (int i = 0; i < prefetch_distance && i < batch_size; i++)
+			memory.prefetch(mb.indices[i]);
+		for (int i = 0; i < batch_size; i++)
+		{
+			if (i + prefetch_distance < batch_size)
+				memory.prefetch(mb.indices[i + prefetch_distance]);
+			Transition& t = memory[mb.indices[i]];
+			memcpy(&X0[i * state_size], t.t1, sizeof(float) * state_size);
+			memcpy(&X0[(batch_size + i) * state_size], t.t0, sizeof(float) * state_size);
+			mb.actions[i] = t.action;
+			mb.rewards[i] = t.reward;
+			mb.dts[i] = t.dt;
+			mb.legal[i] = t.actions;
+		}
+	}
+
+	// one Q-learning step on the minibatch in model.X0, leaves |target - Q| of each sample in errors
+	static void train_minibatch(Model& model, const Minibatch& mb, const Hyperparameters& hp, float nu, float* targets, float* errors, float* weights)
+	{
+		int batch_size = model.batch_size;
+		int num_actions = model.output_size;
+		float output_range = hp.output_upper - hp.output_lower;
+
+		// compute Q1 and Q0 in one pass
+		float* Q1 = model.batch_compute();
+		float* Q0 = &Q1[batch_size * num_actions];
+
+		// calculate rewards
+		masked_max(Q1, mb.legal.data(), num_actions, batch_size, targets);
+		Map<ArrayXf> target_q(targets, batch_size);
+		Map<const ArrayXf> rewards(mb.rewards.data(), batch_size);
+		Map<const ArrayXf> dts(mb.dts.data(), batch_size);
+		target_q = (1.0f / output_range) * ((1.0f / hp.window) * (rewards + (hp.window - dts) * (hp.output_lower + output_range * target_q)) - hp.output_lower);
+		for (int i = 0; i < batch_size; i++)
+			errors[i] = fabsf(targets[i] - Q0[i * num_actions + mb.actions[i]]);
+
+		// calculate target
+		memcpy(model.target, Q0, sizeof(float) * num_actions * batch_size);
+		for (int i = 0; i < batch_size; i++)
+			model.target[i * num_actions + mb.actions[i]] = targets[i];
+
+		// train
+		model.train(nu, weights);
+	}
+
+	TrainingDummy::TrainingDummy(BlackMage& job) : job(job), rotation(job, model)
 	{
 
 	}
@@ -28,14 +145,32 @@ namespace StrikingDummy
 		const int NUM_STEPS_PER_EPISODE = 2500;
 		const int NUM_BATCHES_PER_EPOCH = 50;
 		const int CAPACITY = 1000000;
-		const int BATCH_SIZE = 10000;
-		const float WINDOW = 600000.0f;
-		const float EPS_DECAY = 0.999f;
+		const Hyperparameters HP;
+		const int BATCH_SIZE = HP.batch_size;
+		const float WINDOW = HP.window;
+		const float EPS_DECAY = HP.eps_decay;
 		const float EPS_START = 1.0f;
 		const float EPS_MIN = 0.10f;
-		const float OUTPUT_LOWER = 20.100f;
-		const float OUTPUT_UPPER = 20.650f;
-		const float OUTPUT_RANGE = OUTPUT_UPPER - OUTPUT_LOWER;
+		const float OUTPUT_LOWER = HP.output_lower;
+		const float OUTPUT_UPPER = HP.output_upper;
+		const bool PRIORITIZED = false;
+		const float PRIORITY_ALPHA = 0.6f;
+		const float PRIORITY_EPSILON = 0.001f;
+		const float IS_BETA_START = 0.4f;
+		const float IS_BETA_EPOCHS = 2000.0f;
+		const bool PERSIST_REPLAY = true;
+		const char* REPLAY_FILE = "Weights\\replay";
+		const bool LARGE_PAGES = true;
+		const int PREFETCH_DISTANCE = 8;
+		const char* CHECKPOINT_FILE = "Weights\\checkpoint";
+		const int EVAL_FIGHTS = 32;
+		const int EVAL_SECONDS = 600;
+		const int EVAL_THREADS = 4;
+		const Precision PRECISION = Precision::FP32;	// storage of the batch inputs and activations
+		const bool HALF_WEIGHTS = false;				// reduced precision forward passes also read 16-bit weights
+		const bool PRECISION_BASELINE = true;			// reduced precision also trains an fp32 copy on the same minibatches
+		const int SNAPSHOT_POOL = 256;		// mid-fight snapshots episodes may start from, 0 starts every episode from reset
+		const float SNAPSHOT_START = 0.75f;		// share of episodes that start from a snapshot once there is one
 
 		std::stringstream zz;
 		zz << "lower: " << OUTPUT_LOWER << ", upper: " << OUTPUT_UPPER << std::endl;
@@ -46,13 +181,20 @@ namespace StrikingDummy
 		std::mt19937 rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
 		std::uniform_int_distribution<int> range(0, CAPACITY - 1);
 		std::uniform_real_distribution<float> unif(0.0f, 1.0f);
-		std::vector<int> indices(BATCH_SIZE);
-		std::vector<int> actions(BATCH_SIZE);
-		std::vector<float> rewards(BATCH_SIZE);
+		std::vector<float> targets(BATCH_SIZE);
+		std::vector<float> errors(BATCH_SIZE);
+
+		Minibatch minibatches[2];
+		for (Minibatch& mb : minibatches)
+			mb.resize(BATCH_SIZE);
 
-		Transition* memory = new Transition[CAPACITY];
-		int m_index = 0;
-		int m_size = 0;
+		ReplayMemory memory;
+		if (PERSIST_REPLAY)
+			memory.open(REPLAY_FILE, CAPACITY, job.get_state_size());
+		else
+			memory.init(CAPACITY, LARGE_PAGES);
+
+		float is_beta = IS_BETA_START;
 
 		auto indices_gen = [&]()
 		{
@@ -62,12 +204,16 @@ namespace StrikingDummy
 		// Initialize model
 		int state_size = job.get_state_size();
 		int num_actions = job.get_num_actions();
-		model.init(state_size, num_actions, BATCH_SIZE, false);
-		model.load("Weights\\weights");
+		model.init(state_size, num_actions, BATCH_SIZE, false, job.get_state_flags(), PRECISION);
+		model.half_weights = HALF_WEIGHTS;
 
-		BlackMage& blm = (BlackMage&)job;
+		BlackMage& blm = job;
 
-		float nu = 0.001f;
+		// each episode snapshots one random step of itself, into a random slot once the pool is full
+		std::vector<BlackMage::Snapshot> snapshots;
+		snapshots.reserve(SNAPSHOT_POOL);
+
+		float nu = HP.nu;
 		float eps = EPS_START;
 		float exp = 0.0f;
 		float steps_per_episode = NUM_STEPS_PER_EPISODE;
@@ -75,71 +221,196 @@ namespace StrikingDummy
 		float est_dps = 0.0f;
 		float beta = 0.9f;
 		int epoch_offset = 0;
+		int start_epoch = 0;
 
-		for (int epoch = 0; epoch < NUM_EPOCHS; epoch++)
+		// resume where the last run stopped, otherwise start from the plain weights
+		TrainerState state;
+		if (model.load(CHECKPOINT_FILE, &state) && !state.rng.empty())
+		{
+			start_epoch = state.epoch;
+			epoch_offset = state.epoch_offset;
+			eps = state.eps;
+			is_beta = state.is_beta;
+			nu = state.nu;
+			std::stringstream(state.rng) >> rng;
+			std::stringstream(state.rotation_rng) >> rotation.rng;
+			std::stringstream(state.job_rng) >> job.rng;
+			std::cout << "resuming at epoch " << start_epoch - epoch_offset << std::endl;
+
+			// the replay file runs ahead of the checkpoint, drop what was pushed after it. This is exact
+			// until the ring wraps: once full, the slots from replay_index on hold transitions newer than
+			// the checkpoint instead of the ones they overwrote, and only a copy of the file could bring
+			// those back. An in-memory replay starts empty either way
+			if (PERSIST_REPLAY && state.replay_index >= 0 && !memory.rewind(state.replay_index, state.replay_size))
+				std::cerr << "Replay memory is behind the checkpoint, resuming with all of it" << std::endl;
+		}
+		else
+			model.load("Weights\\weights");
+
+		// prioritized replay: sample proportional to |target - Q|^alpha, correct with IS weights.
+		// Priorities are not checkpointed, a resumed run starts them over
+		SumTree priorities;
+		if (PRIORITIZED)
+		{
+			priorities.init(CAPACITY);
+			for (int i = 0; i < memory.size; i++)
+				priorities.update(i, priorities.max_priority);
+		}
+
+		// the baseline starts from the same weights and sees the same minibatches, so the difference
+		// between the two evaluations is what the precision costs
+		bool use_baseline = PRECISION != Precision::FP32 && PRECISION_BASELINE;
+		Model baseline;
+		std::vector<float> baseline_errors(BATCH_SIZE);
+		if (use_baseline)
+		{
+			baseline.init(state_size, num_actions, BATCH_SIZE, false, job.get_state_flags());
+			baseline.copy(model);
+		}
+
+		auto checkpoint = [&](int next_epoch)
+		{
+			std::stringstream rng_state, rotation_rng_state, job_rng_state;
+			rng_state << rng;
+			rotation_rng_state << rotation.rng;
+			job_rng_state << job.rng;
+
+			state.epoch = next_epoch;
+			state.epoch_offset = epoch_offset;
+			state.eps = eps;
+			state.is_beta = is_beta;
+			state.nu = nu;
+			state.rng = rng_state.str();
+			state.rotation_rng = rotation_rng_state.str();
+			state.job_rng = job_rng_state.str();
+			state.replay_index = memory.index;
+			state.replay_size = memory.size;
+			model.save(CHECKPOINT_FILE, &state);
+		};
+
+		Evaluator evaluator(job.stats, EVAL_FIGHTS, EVAL_SECONDS, EVAL_THREADS);
+		Evaluator baseline_evaluator(job.stats, EVAL_FIGHTS, EVAL_SECONDS, EVAL_THREADS);
+		float eval_eps = eps;
+		Evaluation last_evaluation, last_baseline;
+		last_evaluation.epoch = last_baseline.epoch = -1;
+
+		auto log_evaluation = [&](const Evaluation& evaluation)
+		{
+			std::stringstream ss;
+			ss << "epoch: " << evaluation.epoch << ", eps: " << eval_eps << ", window: " << WINDOW << ", steps: " << steps_per_episode << ", " << evaluation.summary(job) << std::endl;
+			ss << "epoch: " << evaluation.epoch << ", " << Memory::report() << std::endl;
+			Logger::log(ss.str().c_str());
+			std::cout << ss.str();
+		};
+
+		// logged once both evaluations of an epoch are in
+		auto log_precision = [&]()
+		{
+			if (last_evaluation.epoch != last_baseline.epoch || last_evaluation.epoch < 0)
+				return;
+			std::stringstream ss;
+			ss.precision(6);
+			ss << "epoch: " << last_evaluation.epoch << ", fp32 baseline dps: " << last_baseline.dps.mean << " +/- " << last_baseline.dps.ci95();
+			ss << ", " << precision_name(PRECISION) << " - fp32: " << last_evaluation.dps.mean - last_baseline.dps.mean;
+			ss << " +/- " << sqrt(last_evaluation.dps.ci95() * last_evaluation.dps.ci95() + last_baseline.dps.ci95() * last_baseline.dps.ci95()) << std::endl;
+			Logger::log(ss.str().c_str());
+			std::cout << ss.str();
+			last_baseline.epoch = -1;
+		};
+
+		for (int epoch = start_epoch; epoch < NUM_EPOCHS; epoch++)
 		{
 			rotation.reset(eps, exp);
 
 			int num_episodes = NUM_STEPS_PER_EPOCH / steps_per_episode;
 			for (int episode = 0; episode < num_episodes; episode++)
 			{
-				job.reset();
+				if (!snapshots.empty() && unif(rng) < SNAPSHOT_START)
+					blm.restore(snapshots[std::uniform_int_distribution<int>(0, (int)snapshots.size() - 1)(rng)]);
+				else
+					job.reset();
+				int snapshot_step = SNAPSHOT_POOL > 0 ? std::uniform_int_distribution<int>(0, (int)steps_per_episode - 1)(rng) : -1;
 				for (int step = 0; step < (int)steps_per_episode; step++)
+				{
 					rotation.step();
+					if (step != snapshot_step)
+						continue;
+					if ((int)snapshots.size() < SNAPSHOT_POOL)
+					{
+						snapshots.emplace_back();
+						blm.snapshot(snapshots.back());
+					}
+					else
+						blm.snapshot(snapshots[std::uniform_int_distribution<int>(0, SNAPSHOT_POOL - 1)(rng)]);
+				}
 				for (int i = 0; i < (int)steps_per_episode; i++)
 				{
-					memory[m_index] = std::move(job.history[i]);
-					m_index++;
-					if (m_index == CAPACITY)
-						m_index = 0;
-					if (m_size < CAPACITY)
-						m_size++;
+					int slot = memory.push(job.history[i]);
+					if (PRIORITIZED)
+						priorities.update(slot, priorities.max_priority);
 				}
 			}
-			if (m_size == CAPACITY)
+			if (memory.full())
 			{
-				// batch train a bunch
-				for (int batch = 0; batch < NUM_BATCHES_PER_EPOCH; batch++)
+				// gathers into X0, or X0_next when next, and splits it there, off the training thread
+				auto prepare = [&](Minibatch& mb, bool next)
 				{
-					std::generate(indices.begin(), indices.end(), indices_gen);
-
-					// compute Q1
-					for (int i = 0; i < BATCH_SIZE; i++)
-						memcpy(&model.X0[i * state_size], &memory[indices[i]].t1, sizeof(float) * state_size);
+					if (PRIORITIZED)
+					{
+						// stratified: one sample from each of BATCH_SIZE equal slices of the total
+						float segment = priorities.total() / BATCH_SIZE;
+						for (int i = 0; i < BATCH_SIZE; i++)
+							mb.indices[i] = priorities.find(segment * (i + unif(rng)));
+					}
+					else
+						std::generate(mb.indices.begin(), mb.indices.end(), indices_gen);
 
-					float* Q1 = model.batch_compute();
+					gather(memory, mb, next ? model.X0_next : model.X0, state_size, PREFETCH_DISTANCE);
+					model.split_batch(next);
 
-					// calculate rewards
-					for (int i = 0; i < BATCH_SIZE; i++)
+					if (PRIORITIZED)
 					{
-						Transition& t = memory[indices[i]];
-						float* q = &Q1[i * num_actions];
-						float max_q = q[t.actions[0]];
-						auto cend = t.actions.cend();
-						for (auto iter = t.actions.cbegin() + 1; iter != cend; iter++)
+						float total = priorities.total();
+						float max_weight = 0.0f;
+						for (int i = 0; i < BATCH_SIZE; i++)
 						{
-							int index = *iter;
-							if (q[index] > max_q)
-								max_q = q[index];
+							mb.weights[i] = powf(memory.size * priorities.get(mb.indices[i]) / total, -is_beta);
+							max_weight = std::max(max_weight, mb.weights[i]);
 						}
-						max_q = OUTPUT_LOWER + OUTPUT_RANGE * max_q;
-						rewards[i] = (1.0f / OUTPUT_RANGE) * ((1.0f / WINDOW) * (t.reward + (WINDOW - t.dt) * max_q) - OUTPUT_LOWER);
-						actions[i] = t.action;
+						for (int i = 0; i < BATCH_SIZE; i++)
+							mb.weights[i] /= max_weight;
 					}
+				};
 
-					// compute Q0
-					for (int i = 0; i < BATCH_SIZE; i++)
-						memcpy(&model.X0[i * state_size], &memory[indices[i]].t0, sizeof(float) * state_size);
+				// memory is not written to until the next epoch, so gathering ahead is safe
+				prepare(minibatches[0], false);
 
-					model.batch_compute();
+				// batch train a bunch
+				for (int batch = 0; batch < NUM_BATCHES_PER_EPOCH; batch++)
+				{
+					Minibatch& mb = minibatches[batch & 1];
+					std::future<void> next;
+					if (batch + 1 < NUM_BATCHES_PER_EPOCH)
+						next = std::async(std::launch::async, prepare, std::ref(minibatches[(batch + 1) & 1]), true);
+
+					train_minibatch(model, mb, HP, nu, targets.data(), errors.data(), PRIORITIZED ? mb.weights.data() : NULL);
+					if (use_baseline)
+					{
+						memcpy(baseline.X0, model.X0, sizeof(float) * state_size * BATCH_SIZE * 2);
+						baseline.split_batch();
+						train_minibatch(baseline, mb, HP, nu, targets.data(), baseline_errors.data(), PRIORITIZED ? mb.weights.data() : NULL);
+					}
 
-					// calculate target
-					memcpy(model.target, model.X3, sizeof(float) * num_actions * BATCH_SIZE);
-					for (int i = 0; i < BATCH_SIZE; i++)
-						model.target[i * num_actions + actions[i]] = rewards[i];
+					if (next.valid())
+					{
+						next.wait();
+						model.swap_batch();
+					}
 
-					// train
-					model.train(nu);
+					// applied after the next minibatch is drawn, so the tree is never read and written at once
+					if (PRIORITIZED)
+						for (int i = 0; i < BATCH_SIZE; i++)
+							priorities.update(mb.indices[i], powf(errors[i] + PRIORITY_EPSILON, PRIORITY_ALPHA));
 				}
 
 				model.copyToHost();
@@ -148,24 +419,22 @@ namespace StrikingDummy
 				eps *= EPS_DECAY;
 				if (eps < EPS_MIN)
 					eps = EPS_MIN;
+				is_beta = std::min(is_beta + (1.0f - IS_BETA_START) / IS_BETA_EPOCHS, 1.0f);
 
 				int _epoch = epoch - epoch_offset;
 
-				// test model
+				// evaluate a snapshot of the policy in the background, skipped if the last one is still running
 				if (_epoch % 50 == 0)
 				{
-					test();
-
-					float dps = job.total_damage / job.timeline.time;
-					//avg_dps = 0.9f * avg_dps + 0.1f * (0.1f * job.total_damage / job.timeline.time);
-					//est_dps = avg_dps / (1.0f - beta);
-					//beta *= 0.9f;
-
-					std::stringstream ss;
-					//ss << "epoch: " << _epoch << ", eps: " << eps << ", window: " << WINDOW << ", steps: " << steps_per_episode << ", avg dps: " << est_dps << ", " << "dps: " << dps << ", xenos: " << blm.xeno_count << ", f1s: " << blm.f1_count << ", f4s: " << blm.f4_count << ", b4s: " << blm.b4_count << ", t3s: " << blm.t3_count << ", transposes: " << blm.transpose_count << ", despairs: " << blm.despair_count << ", lucids: " << blm.lucid_count << ", pots: " << blm.pot_count << std::endl;
-					ss << "epoch: " << _epoch << ", eps: " << eps << ", window: " << WINDOW << ", steps: " << steps_per_episode << ", " << "dps: " << dps << ", xenos: " << blm.xeno_count << ", f1s: " << blm.f1_count << ", f4s: " << blm.f4_count << ", b4s: " << blm.b4_count << ", t3s: " << blm.t3_count << ", transposes: " << blm.transpose_count << ", despairs: " << blm.despair_count << ", lucids: " << blm.lucid_count << ", pots: " << blm.pot_count << std::endl;
-					Logger::log(ss.str().c_str());
-					std::cout << ss.str();
+					if (evaluator.start(model.inference, _epoch))
+					{
+						eval_eps = eps;
+						if (use_baseline)
+						{
+							baseline.copyToHost();
+							baseline_evaluator.start(baseline.inference, _epoch);
+						}
+					}
 
 					if (_epoch % 500 == 0)
 					{
@@ -173,13 +442,236 @@ namespace StrikingDummy
 						filename << "Weights\\weights-" << _epoch << std::flush;
 						model.save(filename.str().c_str());
 					}
+
+					checkpoint(epoch + 1);
 				}
 			}
 			else
 				epoch_offset++;
+
+			Evaluation evaluation;
+			if (evaluator.poll(evaluation))
+			{
+				log_evaluation(evaluation);
+				last_evaluation = evaluation;
+				log_precision();
+			}
+			if (baseline_evaluator.poll(last_baseline))
+				log_precision();
+		}
+
+		if (evaluator.busy())
+		{
+			last_evaluation = evaluator.wait();
+			log_evaluation(last_evaluation);
+		}
+		if (baseline_evaluator.busy())
+			last_baseline = baseline_evaluator.wait();
+		log_precision();
+
+		long long end_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+		std::cout << "running time: " << (end_time - start_time) / 1000000000.0 << " seconds" << std::endl;
+
+		Logger::close();
+	}
+
+	void TrainingDummy::train_population(int size)
+	{
+		std::cout.precision(4);
+
+		long long start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+		const int NUM_EPOCHS = 1000000;
+		const int NUM_STEPS_PER_EPOCH = 10000;
+		const int NUM_STEPS_PER_EPISODE = 2500;
+		const int NUM_BATCHES_PER_EPOCH = 50;
+		const int CAPACITY = 1000000;
+		const float EPS_START = 1.0f;
+		const float EPS_MIN = 0.10f;
+		const char* REPLAY_FILE = "Weights\\replay";
+		const int PREFETCH_DISTANCE = 8;
+		const int EVAL_INTERVAL = 50;
+		const int EVAL_FIGHTS = 32;
+		const int EVAL_SECONDS = 600;
+		const int EVAL_THREADS = 2;
+		const int EXPLOIT_INTERVAL = 500;		// epochs between replacing the weakest members
+		const float EXPLOIT_FRACTION = 0.25f;	// share of the population replaced each time
+		const float PERTURB_DOWN = 0.8f;
+		const float PERTURB_UP = 1.25f;
+
+		struct Member
+		{
+			Model model;
+			Hyperparameters hp;
+			float eps = 0.0f;
+			float dps = 0.0f;
+			int evaluated = -1;		// epoch of the latest evaluation that counts
+			int replaced = -1;		// epoch its weights were last overwritten
+		};
+
+		std::mt19937 rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+		std::uniform_int_distribution<int> range(0, CAPACITY - 1);
+		std::uniform_real_distribution<float> unif(0.0f, 1.0f);
+
+		// one replay memory for the whole population
+		ReplayMemory memory;
+		memory.open(REPLAY_FILE, CAPACITY, job.get_state_size());
+
+		int state_size = job.get_state_size();
+		int num_actions = job.get_num_actions();
+
+		// batch_size is fixed per member, the device buffers are sized for it
+		auto perturb = [&](Hyperparameters& hp)
+		{
+			auto factor = [&]() { return unif(rng) < 0.5f ? PERTURB_DOWN : PERTURB_UP; };
+			hp.nu *= factor();
+			hp.window *= factor();
+			hp.eps_decay = 1.0f - (1.0f - hp.eps_decay) * factor();
+		};
+
+		// every member starts from the same weights, all but the first with perturbed settings
+		std::vector<Member> members(size);
+		std::vector<std::unique_ptr<BlackMageRotation>> actors;
+		std::vector<std::unique_ptr<Evaluator>> evaluators;
+		for (int i = 0; i < size; i++)
+		{
+			Member& m = members[i];
+			m.eps = EPS_START;
+			if (i > 0)
+				perturb(m.hp);
+			m.model.init(state_size, num_actions, m.hp.batch_size, false, job.get_state_flags());
+			m.model.load("Weights\\weights");
+			actors.emplace_back(new BlackMageRotation(job, m.model));
+			evaluators.emplace_back(new Evaluator(job.stats, EVAL_FIGHTS, EVAL_SECONDS, EVAL_THREADS));
+		}
+
+		Minibatch minibatches[2];
+		std::vector<float> targets;
+		std::vector<float> errors;
+
+		auto describe = [&](int i)
+		{
+			std::stringstream ss;
+			ss << "member " << i << ", nu: " << members[i].hp.nu << ", window: " << members[i].hp.window << ", eps decay: " << members[i].hp.eps_decay << ", eps: " << members[i].eps;
+			return ss.str();
+		};
+
+		int epoch_offset = 0;
+		for (int epoch = 0; epoch < NUM_EPOCHS; epoch++)
+		{
+			// members take turns collecting experience, every member learns from all of it
+			int actor = epoch % size;
+			actors[actor]->reset(members[actor].eps, 0.0f);
+			int num_episodes = NUM_STEPS_PER_EPOCH / NUM_STEPS_PER_EPISODE;
+			for (int episode = 0; episode < num_episodes; episode++)
+			{
+				job.reset();
+				for (int step = 0; step < NUM_STEPS_PER_EPISODE; step++)
+					actors[actor]->step();
+				for (int i = 0; i < NUM_STEPS_PER_EPISODE; i++)
+					memory.push(job.history[i]);
+			}
+			if (!memory.full())
+			{
+				epoch_offset++;
+				continue;
+			}
+
+			for (Member& m : members)
+			{
+				for (Minibatch& mb : minibatches)
+					mb.resize(m.hp.batch_size);
+				targets.resize(m.hp.batch_size);
+				errors.resize(m.hp.batch_size);
+
+				auto prepare = [&](Minibatch& mb, bool next)
+				{
+					std::generate(mb.indices.begin(), mb.indices.end(), [&]() { return range(rng); });
+					gather(memory, mb, next ? m.model.X0_next : m.model.X0, state_size, PREFETCH_DISTANCE);
+					m.model.split_batch(next);
+				};
+
+				prepare(minibatches[0], false);
+				for (int batch = 0; batch < NUM_BATCHES_PER_EPOCH; batch++)
+				{
+					Minibatch& mb = minibatches[batch & 1];
+					std::future<void> next;
+					if (batch + 1 < NUM_BATCHES_PER_EPOCH)
+						next = std::async(std::launch::async, prepare, std::ref(minibatches[(batch + 1) & 1]), true);
+
+					train_minibatch(m.model, mb, m.hp, m.hp.nu, targets.data(), errors.data(), NULL);
+
+					if (next.valid())
+					{
+						next.wait();
+						m.model.swap_batch();
+					}
+				}
+				m.model.copyToHost();
+
+				m.eps *= m.hp.eps_decay;
+				if (m.eps < EPS_MIN)
+					m.eps = EPS_MIN;
+			}
+
+			int _epoch = epoch - epoch_offset;
+
+			if (_epoch % EVAL_INTERVAL == 0)
+				for (int i = 0; i < size; i++)
+					evaluators[i]->start(members[i].model.inference, _epoch);
+
+			for (int i = 0; i < size; i++)
+			{
+				Evaluation evaluation;
+				if (!evaluators[i]->poll(evaluation) || evaluation.epoch <= members[i].replaced)
+					continue;
+				members[i].dps = evaluation.dps.mean;
+				members[i].evaluated = evaluation.epoch;
+				std::stringstream ss;
+				ss << "epoch: " << evaluation.epoch << ", " << describe(i) << ", " << evaluation.summary(job) << std::endl;
+				Logger::log(ss.str().c_str());
+				std::cout << ss.str();
+			}
+
+			// exploit and explore: the weakest take over the weights and settings of one of the strongest,
+			// then perturb the settings. Only once every member has been scored since it last changed
+			bool scored = std::all_of(members.begin(), members.end(), [](const Member& m) { return m.evaluated >= 0; });
+			if (_epoch > 0 && _epoch % EXPLOIT_INTERVAL == 0 && scored && size > 1)
+			{
+				std::vector<int> order(size);
+				for (int i = 0; i < size; i++)
+					order[i] = i;
+				std::sort(order.begin(), order.end(), [&](int a, int b) { return members[a].dps > members[b].dps; });
+
+				std::stringstream filename;
+				filename << "Weights\\weights-" << _epoch << std::flush;
+				members[order[0]].model.save(filename.str().c_str());
+
+				int count = std::max(1, std::min(size / 2, (int)(size * EXPLOIT_FRACTION)));
+				for (int k = 0; k < count; k++)
+				{
+					int winner = order[std::uniform_int_distribution<int>(0, count - 1)(rng)];
+					int loser = order[size - 1 - k];
+					Member& m = members[loser];
+					m.model.copy(members[winner].model);
+					m.hp = members[winner].hp;
+					perturb(m.hp);
+					m.eps = members[winner].eps;
+					m.evaluated = -1;
+					m.replaced = _epoch;
+
+					std::stringstream ss;
+					ss << "epoch: " << _epoch << ", member " << loser << " (" << members[loser].dps << " dps) replaced by member " << winner << " (" << members[winner].dps << " dps), " << describe(loser) << std::endl;
+					Logger::log(ss.str().c_str());
+					std::cout << ss.str();
+				}
+			}
 		}
 
-		delete[] memory;
+		for (int i = 0; i < size; i++)
+			if (evaluators[i]->busy())
+				evaluators[i]->wait();
 
 		long long end_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
 
@@ -198,31 +690,47 @@ namespace StrikingDummy
 
 	void TrainingDummy::trace()
 	{
+		// off: measured with procs on it hits rarely and costs time, and its rounded keys can hand a state
+		// another state's outputs. Turn on only after checking hit rate and decisions with the trained weights.
+		const bool Q_CACHE = false;
+
 		Logger::open();
 
 		std::cout.precision(4);
 
-		BlackMage& blm = (BlackMage&)job;
+		BlackMage& blm = job;
 		blm.reset();
 
 		Logger::log("=============\n");
 
-		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false);
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
 		model.load("Weights\\weights");
 
 		rotation.eps = 0.0f;
 
+		QCache cache;
+		if (Q_CACHE)
+			rotation.cache = &cache;
+
 		while (blm.timeline.time < 7 * 24 * 3600000)
 			rotation.step();
 
+		rotation.cache = NULL;
+
 		std::stringstream ss;
 		ss << "DPS: " << 1000.0f / blm.timeline.time * blm.total_damage << "\n";
-		ss << "T3 uptime: " << 100.0f / blm.timeline.time * blm.total_dot_time << "%\n";
-		ss << "F4 % damage: " << 100.0f / blm.total_damage * blm.total_f4_damage << "%\n";
-		ss << "Desp % damage: " << 100.0f / blm.total_damage * blm.total_desp_damage << "%\n";
-		ss << "Xeno % damage: " << 100.0f / blm.total_damage * blm.total_xeno_damage << "%\n";
-		ss << "T3 % damage: " << 100.0f / blm.total_damage * blm.total_t3_damage << "%\n";
-		ss << "Dot % damage: " << 100.0f / blm.total_damage * blm.total_dot_damage << "%\n=============" << std::endl;
+		if (Q_CACHE)
+			ss << "Q cache hit rate: " << 100.0 * cache.hit_rate() << "% of " << cache.hits + cache.misses << " decisions\n";
+		const Metrics& metrics = blm.metrics;
+		ss << "T3 uptime: " << 100.0 * metrics.buff_time[BlackMage::THUNDER_DOT] / metrics.time << "%\n";
+		for (int action = 0; action < (int)metrics.casts.size(); action++)
+		{
+			if (metrics.damage[action] > 0.0)
+				ss << metrics.action_names[action] << " % damage: " << 100.0 * metrics.damage[action] / metrics.total_damage() << "%\n";
+			if (metrics.tick_damage[action] > 0.0)
+				ss << metrics.action_names[action] << " dot % damage: " << 100.0 * metrics.tick_damage[action] / metrics.total_damage() << "%\n";
+		}
+		ss << "=============" << std::endl;
 		Logger::log(ss.str().c_str());
 		
 		int length = blm.history.size() - 1;
@@ -285,15 +793,20 @@ namespace StrikingDummy
 
 	void TrainingDummy::metrics()
 	{
+		if (!Metrics::enabled)
+		{
+			std::cerr << "metrics needs the Metrics configuration, which defines SD_METRICS" << std::endl;
+			return;
+		}
+
 		Logger::open();
 
 		std::cout.precision(2);
 
-		BlackMage& blm = (BlackMage&)job;
+		BlackMage& blm = job;
 		blm.reset();
-		blm.metrics_enabled = true;
 
-		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false);
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
 		model.load("Weights\\weights");
 
 		rotation.eps = 0.0f;
@@ -301,16 +814,12 @@ namespace StrikingDummy
 		while (blm.timeline.time < 24 * 3600000)
 			rotation.step();
 
-		std::vector<int>* dists[] = { &blm.t3_dist, &blm.t3p_dist, &blm.swift_dist, &blm.triple_dist, &blm.sharp_dist, &blm.ll_dist, &blm.mf_dist };
-		std::stringstream ss;
-		for (int i = 0; i < 7; i++)
-		{
-			for (int t : *dists[i])
-				ss << 0.001 * t << ",";
-			ss << std::endl;
-		}
-		Logger::log(ss.str().c_str());
+		Logger::log(blm.metrics.csv().c_str());
 		Logger::close();
+
+		std::fstream fs;
+		fs.open("metrics.json", std::fstream::out | std::fstream::trunc);
+		fs << blm.metrics.json();
 	}
 
 	void TrainingDummy::dist(int seconds, int times)
@@ -319,9 +828,9 @@ namespace StrikingDummy
 
 		std::cout.precision(2);
 
-		BlackMage& blm = (BlackMage&)job;
+		BlackMage& blm = job;
 
-		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false);
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
 		model.load("Weights\\weights");
 
 		rotation.eps = 0.0f;
@@ -342,20 +851,50 @@ namespace StrikingDummy
 		Logger::close();
 	}
 
+	// a is the job's stats with weights_a, b is stats_b with weights_b: two checkpoints under the same
+	// stats, or one checkpoint under two gear sets
+	void TrainingDummy::compare(const char* weights_a, const char* weights_b, const Stats& stats_b, int seconds, int fights)
+	{
+		BlackMage& blm = job;
+
+		Model model_b;
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		model_b.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		if (!model.load(weights_a) || !model_b.load(weights_b))
+			return;
+
+		Logger::open();
+
+		PairedEvaluation result = StrikingDummy::compare(blm.stats, model.inference, stats_b, model_b.inference, fights, seconds);
+
+		std::stringstream ss;
+		ss << weights_a << " vs " << weights_b << ", " << seconds << " s fights: " << result.summary() << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+
+		Logger::close();
+	}
+
 	void TrainingDummy::study()
 	{
+		const bool Q_CACHE = false;		// see trace
+
 		Logger::open();
 
 		std::cout.precision(4);
 
-		BlackMage& blm = (BlackMage&)job;
+		BlackMage& blm = job;
 		blm.reset();
 
-		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false);
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
 		model.load("Weights\\weights");
 
 		rotation.eps = 0.0f;
 
+		QCache cache;
+		if (Q_CACHE)
+			rotation.cache = &cache;
+
 		std::unordered_map<std::string, int> lines_map;
 		int total_rotations = 0;
 		const int TOTAL_ROTATIONS = 1000000;
@@ -411,6 +950,8 @@ namespace StrikingDummy
 			std::cout << "Total rotations: " << total_rotations << std::endl;
 		}
 
+		rotation.cache = NULL;
+
 		std::vector<std::pair<std::string, int>> lines(lines_map.begin(), lines_map.end());
 		std::sort(lines.begin(), lines.end(), [](std::pair<std::string, int>& a, std::pair<std::string, int>& b) { return a.second > b.second; });
 
@@ -437,6 +978,8 @@ namespace StrikingDummy
 		std::stringstream ss;
 		ss << "Total rotation count: " << total_rotations << std::endl;
 		ss << "Unique rotation count: " << lines.size() << std::endl;
+		if (Q_CACHE)
+			ss << "Q cache hit rate: " << 100.0 * cache.hit_rate() << "% of " << cache.hits + cache.misses << " decisions" << std::endl;
 		ss << "=============" << std::endl;
 		ss << length << " unique rotations listed below account for " << 100.0f * sum / total_rotations << "% of rotations logged.\n";
 		
@@ -463,4 +1006,275 @@ namespace StrikingDummy
 
 		Logger::close();
 	}
+
+	void TrainingDummy::opener(int seconds, int seed)
+	{
+		Logger::open();
+
+		std::cout.precision(6);
+
+		// the job is shared with the other modes, procs are back on once the search is done
+		BlackMage& blm = job;
+		bool random_procs = blm.random_procs;
+		blm.random_procs = false;
+		blm.rng.seed(seed);
+		blm.reset();
+
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		model.load("Weights\\weights");
+
+		OpenerSearch search(seconds);
+
+		std::stringstream ss;
+		ss << "policy opener, " << OpenerSearch::format(blm, search.rollout(blm, model.inference)) << "=============" << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+
+		long long start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		OpenerSearch::Result result = search.search(blm, &model.inference);
+		long long end_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+		ss.str("");
+		ss << "best opener, " << OpenerSearch::format(blm, result);
+		ss << "nodes: " << search.nodes << ", pruned: " << search.pruned << ", transpositions: " << search.transpositions;
+		ss << ", time: " << (end_time - start_time) / 1000000000.0 << " seconds\n=============" << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+		Logger::close();
+
+		blm.random_procs = random_procs;
+	}
+
+	void TrainingDummy::distill(int fights, int seconds)
+	{
+		Logger::open();
+
+		std::cout.precision(6);
+
+		BlackMage& blm = job;
+
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		model.load("Weights\\weights");
+
+		// a little exploration shows the tree states slightly off the policy's own path, which it is
+		// bound to reach once it disagrees with the network
+		const float SAMPLE_EPS = 0.05f;
+		const int TEST_FIGHTS = 256;
+		const char* TREE_FILE = "Weights\\tree";
+
+		int num_features = blm.get_state_size();
+		int time = seconds * 1000;
+
+		std::vector<std::vector<float>> fight_states(fights);
+		std::vector<std::vector<int>> fight_labels(fights);
+		std::vector<std::vector<unsigned int>> fight_legal(fights);
+
+		long long start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		parallel_for(fights, [&](int fight)
+		{
+			BlackMage sim(blm.stats);
+			sim.rng.seed(fight);
+			BlackMageRotation sampler(sim, model);
+			sampler.rng.seed(fight);
+			sampler.reset(SAMPLE_EPS, 0.0f);
+
+			sim.reset();
+			while (sim.timeline.time < time)
+			{
+				if (sim.actions.size() > 1)
+				{
+					const float* state = sim.get_state();
+					fight_states[fight].insert(fight_states[fight].end(), state, state + num_features);
+					fight_labels[fight].push_back(model.inference.select(state, sim.actions));
+					unsigned int legal = 0;
+					for (int action : sim.actions)
+						legal |= 1u << action;
+					fight_legal[fight].push_back(legal);
+				}
+				sampler.step();
+			}
+		});
+
+		std::vector<float> states;
+		std::vector<int> labels;
+		std::vector<unsigned int> legal;
+		for (int fight = 0; fight < fights; fight++)
+		{
+			states.insert(states.end(), fight_states[fight].begin(), fight_states[fight].end());
+			labels.insert(labels.end(), fight_labels[fight].begin(), fight_labels[fight].end());
+			legal.insert(legal.end(), fight_legal[fight].begin(), fight_legal[fight].end());
+		}
+		fight_states.clear();
+		fight_labels.clear();
+		fight_legal.clear();
+
+		DecisionTree built;
+		built.fit(states, labels, legal, num_features, blm.get_num_actions());
+		built.save(TREE_FILE);
+		long long end_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+		// everything below runs on the tree as read back from the file, which is what gets shipped
+		DecisionTree tree;
+		if (!tree.load(TREE_FILE))
+		{
+			std::cerr << "could not load " << TREE_FILE << std::endl;
+			Logger::close();
+			return;
+		}
+
+		long long fitted = 0;
+		for (size_t i = 0; i < labels.size(); i++)
+			if (tree.select(&states[i * num_features], legal[i]) == labels[i])
+				fitted++;
+
+		std::stringstream ss;
+		ss << "samples: " << labels.size() << ", fit: " << 100.0 * fitted / std::max<size_t>(1, labels.size()) << "%, nodes: " << tree.nodes.size() << ", leaves: " << tree.leaves() << ", depth: " << tree.depth();
+		ss << ", time: " << (end_time - start_time) / 1000000000.0 << " seconds" << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+
+		// held out fights: agreement is measured along the network's own path, dps of each policy on its own
+		std::vector<float> network_dps(TEST_FIGHTS);
+		std::vector<float> tree_dps(TEST_FIGHTS);
+		std::vector<int> decisions(TEST_FIGHTS, 0);
+		std::vector<int> agreements(TEST_FIGHTS, 0);
+		parallel_for(TEST_FIGHTS, [&](int i)
+		{
+			BlackMage sim(blm.stats);
+
+			sim.rng.seed(fights + i);
+			sim.reset();
+			while (sim.timeline.time < time)
+			{
+				int action = sim.actions[0];
+				if (sim.actions.size() > 1)
+				{
+					action = model.inference.select(sim.get_state(), sim.actions);
+					decisions[i]++;
+					if (tree.select(sim.get_state(), sim.actions) == action)
+						agreements[i]++;
+				}
+				sim.use_action(action);
+				sim.advance<BlackMage>();
+			}
+			network_dps[i] = 1000.0f * sim.total_damage / sim.timeline.time;
+
+			BlackMageTreeRotation rotation(sim, tree);
+			sim.rng.seed(fights + i);
+			sim.reset();
+			while (sim.timeline.time < time)
+				rotation.step();
+			tree_dps[i] = 1000.0f * sim.total_damage / sim.timeline.time;
+		});
+
+		RunningStat network, distilled, delta;
+		long long total_decisions = 0, total_agreements = 0;
+		for (int i = 0; i < TEST_FIGHTS; i++)
+		{
+			network.add(network_dps[i]);
+			distilled.add(tree_dps[i]);
+			delta.add(tree_dps[i] - network_dps[i]);
+			total_decisions += decisions[i];
+			total_agreements += agreements[i];
+		}
+
+		// cost of a single decision on the sampled states, network against tree. Both are handed the
+		// usable actions in the form they take, built ahead of the timed loops
+		int num_timed = (int)std::min<size_t>(labels.size(), 100000);
+		std::vector<std::vector<int>> actions(num_timed);
+		for (int i = 0; i < num_timed; i++)
+			for (int action = 0; action < blm.get_num_actions(); action++)
+				if (legal[i] & (1u << action))
+					actions[i].push_back(action);
+		volatile int sink = 0;
+		start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		for (int i = 0; i < num_timed; i++)
+			sink = sink + model.inference.select(&states[(size_t)i * num_features], actions[i]);
+		long long network_time = std::chrono::high_resolution_clock::now().time_since_epoch().count() - start_time;
+		start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		for (int i = 0; i < num_timed; i++)
+			sink = sink + tree.select(&states[(size_t)i * num_features], legal[i]);
+		long long tree_time = std::chrono::high_resolution_clock::now().time_since_epoch().count() - start_time;
+
+		ss.str("");
+		ss << "agreement: " << 100.0 * total_agreements / std::max(1LL, total_decisions) << "% of " << total_decisions << " decisions" << std::endl;
+		ss << "network dps: " << network.mean << " +/- " << network.ci95() << std::endl;
+		ss << "tree dps: " << distilled.mean << " +/- " << distilled.ci95() << std::endl;
+		ss << "delta: " << delta.mean << " +/- " << delta.ci95() << " (" << TEST_FIGHTS << " seeded fights)" << std::endl;
+		ss << "ns per decision, network: " << (double)network_time / num_timed << ", tree: " << (double)tree_time / num_timed << std::endl;
+		ss << "=============" << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+		Logger::close();
+	}
+
+	void TrainingDummy::record(int seconds, unsigned int seed)
+	{
+		Logger::open();
+
+		std::cout.precision(6);
+
+		BlackMage& blm = job;
+
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		model.load("Weights\\weights");
+
+		rotation.eps = 0.0f;
+
+		ActionScript script;
+		script.record(blm, rotation, seed, seconds);
+		script.save("Weights\\script");
+
+		// replaying under the recording's own stats has to use every step and land on the same damage
+		ReplayResult replay = script.replay(blm.stats);
+		bool reproduced = replay.illegal.empty() && replay.damage == blm.total_damage;
+
+		std::stringstream ss;
+		ss << "recorded " << script.steps.size() << " steps, dps: " << 1000.0f * blm.total_damage / blm.timeline.time;
+		ss << ", replayed dps: " << replay.dps() << ", illegal steps: " << replay.illegal.size() << std::endl;
+		if (reproduced)
+			ss << "replay reproduces the recording" << std::endl;
+		else
+		{
+			ss << "REPLAY MISMATCH: recorded damage " << blm.total_damage << ", replayed " << replay.damage;
+			if (!replay.illegal.empty())
+				ss << ", first illegal step " << replay.illegal.front() << " (action " << script.steps[replay.illegal.front()].action << " at " << script.steps[replay.illegal.front()].time << " ms)";
+			ss << std::endl;
+			std::cerr << "Replaying the recorded script did not reproduce the fight" << std::endl;
+		}
+		ss << "=============" << std::endl;
+		Logger::log(ss.str().c_str());
+		std::cout << ss.str();
+		Logger::close();
+	}
+
+	void TrainingDummy::serve(const char* path)
+	{
+		const int MAX_BATCH = 32;
+		const int MAX_LATENCY = 20;		// us a request waits for others to batch with
+
+		std::cout.precision(4);
+
+		BlackMage& blm = job;
+
+		model.init(blm.get_state_size(), blm.get_num_actions(), 1, false, blm.get_state_flags());
+		if (!model.load("Weights\\weights"))
+		{
+			std::cerr << "could not load Weights\\weights" << std::endl;
+			return;
+		}
+
+		PolicyServer server(model.inference, MAX_BATCH, MAX_LATENCY);
+		if (!server.start(path))
+			return;
+
+		std::cout << "serving on " << path << ", press enter to stop" << std::endl;
+		std::cin.get();
+		server.stop();
+
+		PolicyServer::Statistics statistics = server.get_statistics();
+		InferenceQueue::Statistics batching = server.get_batching();
+		std::cout << statistics.connections << " connections, " << statistics.requests << " requests, mean batch: " << batching.mean_batch_size();
+		std::cout << ", latency p50: " << statistics.percentile(0.5) << "us, p99: " << statistics.percentile(0.99) << "us" << std::endl;
+	}
 }
\ No newline at end of file
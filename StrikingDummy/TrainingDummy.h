@@ -1,25 +1,42 @@
 #pragma once
 
-#include "Job.h"
+#include "BlackMage.h"
 #include "Model.h"
 #include "Rotation.h"
 
 namespace StrikingDummy
 {
+	// settings train() starts from and that population training varies between its members
+	struct Hyperparameters
+	{
+		float nu = 0.001f;
+		float eps_decay = 0.999f;
+		float window = 600000.0f;
+		float output_lower = 20.100f;
+		float output_upper = 20.650f;
+		int batch_size = 10000;
+	};
+
 	struct TrainingDummy
 	{
-		Job& job;
+		BlackMage& job;
 		Model model;
-		ModelRotation rotation;
+		BlackMageRotation rotation;
 
-		TrainingDummy(Job& job);
+		TrainingDummy(BlackMage& job);
 		~TrainingDummy();
 
 		void train();
+		void train_population(int size);
 		void test();
 		void trace();
 		void metrics();
 		void dist(int seconds, int times);
+		void compare(const char* weights_a, const char* weights_b, const Stats& stats_b, int seconds, int fights);
 		void study();
+		void opener(int seconds, int seed);
+		void distill(int fights, int seconds);
+		void record(int seconds, unsigned int seed);
+		void serve(const char* path);
 	};
 }
\ No newline at end of file
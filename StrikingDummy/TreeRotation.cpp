@@ -0,0 +1,27 @@
+#include "Rotation.h"
+#include "Job.h"
+#include "BlackMage.h"
+#include "DecisionTree.h"
+
+namespace StrikingDummy
+{
+	template <typename J>
+	TreeRotation<J>::TreeRotation(J& job, const DecisionTree& tree) : Rotation(job), tree(tree)
+	{
+
+	}
+
+	template <typename J>
+	void TreeRotation<J>::step()
+	{
+		J& job = static_cast<J&>(this->job);
+		if (job.actions.size() == 1)
+			job.use_action(job.actions[0]);
+		else
+			job.use_action(tree.select(job.get_state(), job.actions));
+		job.template advance<J>();
+	}
+
+	template struct TreeRotation<Job>;
+	template struct TreeRotation<BlackMage>;
+}
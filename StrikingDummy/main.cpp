@@ -1,6 +1,7 @@
 #include "StrikingDummy.h"
 #include "TrainingDummy.h"
 #include "BlackMage.h"
+#include "GearOptimizer.h"
 #include "Logger.h"
 #include <iostream>
 
@@ -28,13 +29,25 @@ int main()
 	//stats.determination = 1192;
 	//stats.skill_speed = 1939;
 
+	// gear optimizer over all splits of the same substat total, in steps of 4 materia
+	//StrikingDummy::GearSpace space = { stats, 9178, 4 * 36, { 380, 380, 340, 380 }, { 4000, 4000, 4000, 4000 } };
+	//StrikingDummy::GearOptimizer optimizer;
+	//optimizer.run(space, "Weights\\weights");
+	//optimizer.rescore(space, "Weights\\script");
+
 	StrikingDummy::BlackMage blm(stats);
 	StrikingDummy::TrainingDummy dummy(blm);
 	StrikingDummy::StrikingDummy practice(blm);
 	dummy.train();
+	//dummy.train_population(8);
 	//dummy.trace();
 	//dummy.metrics();
 	//dummy.dist(510, 10000);
+	//dummy.compare("Weights\\weights-0", "Weights\\weights", stats, 510, 1000);
 	//dummy.study();
+	//dummy.opener(12, 0);
+	//dummy.distill(1000, 600);
+	//dummy.record(600, 0);
+	//dummy.serve("StrikingDummy.sock");
 	//practice.start();
 }
\ No newline at end of file